@@ -0,0 +1,227 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+// Element-wise arithmetic kernels over arrays, used by the benchmarks with SoA data.
+// dst may be one of the operands. The kernels of float and double are vectorized with the
+// SIMD layer, other types, LNS types included, run the scalar loop with their own operators.
+
+#include <cstddef>
+#include "simd.hpp"
+#include "utilities.hpp"
+
+// dst[i] = op(a[i], b[i]), op is also applied to whole vectors when the type has SIMD kernels
+template<typename T, typename Op>
+void batchApply(const T* a, const T* b, T* dst, size_t n, const Op& op)
+{
+    for(size_t i = 0; i < n; ++i)
+        dst[i] = op(a[i], b[i]);
+}
+
+// dst[i] = op(a[i], b[i], c[i])
+template<typename T, typename Op>
+void batchApply3(const T* a, const T* b, const T* c, T* dst, size_t n, const Op& op)
+{
+    for(size_t i = 0; i < n; ++i)
+        dst[i] = op(a[i], b[i], c[i]);
+}
+
+// best[i] = min(best[i], d[i]), and labels[i] = index where d[i] is strictly smaller
+template<typename T>
+void batchMinIndex(const T* d, int index, T* best, int* labels, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(d[i] < best[i])
+        {
+            best[i] = d[i];
+            labels[i] = index;
+        }
+    }
+}
+
+#ifndef NO_SIMD
+
+template<typename S, typename Op>
+void batchApplySimd(const S* a, const S* b, S* dst, size_t n, const Op& op)
+{
+    const size_t width = SIMD_WIDTH(S);
+    size_t i;
+
+    for(i = 0; i + width <= n; i += width)
+        simdStore<S>(dst + i, op(simdLoad<S>(a + i), simdLoad<S>(b + i)));
+
+    for(; i < n; ++i)
+        dst[i] = op(a[i], b[i]);
+}
+
+template<typename Op>
+void batchApply(const float* a, const float* b, float* dst, size_t n, const Op& op)
+{
+    batchApplySimd<float>(a, b, dst, n, op);
+}
+
+template<typename Op>
+void batchApply(const double* a, const double* b, double* dst, size_t n, const Op& op)
+{
+    batchApplySimd<double>(a, b, dst, n, op);
+}
+
+template<typename S, typename Op>
+void batchApply3Simd(const S* a, const S* b, const S* c, S* dst, size_t n, const Op& op)
+{
+    const size_t width = SIMD_WIDTH(S);
+    size_t i;
+
+    for(i = 0; i + width <= n; i += width)
+        simdStore<S>(dst + i, op(simdLoad<S>(a + i), simdLoad<S>(b + i), simdLoad<S>(c + i)));
+
+    for(; i < n; ++i)
+        dst[i] = op(a[i], b[i], c[i]);
+}
+
+template<typename Op>
+void batchApply3(const float* a, const float* b, const float* c, float* dst, size_t n, const Op& op)
+{
+    batchApply3Simd<float>(a, b, c, dst, n, op);
+}
+
+template<typename Op>
+void batchApply3(const double* a, const double* b, const double* c, double* dst, size_t n, const Op& op)
+{
+    batchApply3Simd<double>(a, b, c, dst, n, op);
+}
+
+template<typename S>
+void batchMinIndexSimd(const S* d, int index, S* best, int* labels, size_t n)
+{
+    const size_t width = SIMD_WIDTH(S);
+    size_t i;
+
+    for(i = 0; i + width <= n; i += width)
+    {
+        SIMD_VECTOR(S) x = simdLoad<S>(d + i);
+        SIMD_VECTOR(S) y = simdLoad<S>(best + i);
+        SIMD_MASK(S) smaller = x < y;
+        simdStore<S>(best + i, simdBlend<S>(smaller, x, y));
+        for(size_t j = 0; j < width; ++j)
+            labels[i + j] = smaller[j] ? index : labels[i + j];
+    }
+
+    for(; i < n; ++i)
+    {
+        if(d[i] < best[i])
+        {
+            best[i] = d[i];
+            labels[i] = index;
+        }
+    }
+}
+
+void batchMinIndex(const float* d, int index, float* best, int* labels, size_t n)
+{
+    batchMinIndexSimd<float>(d, index, best, labels, n);
+}
+
+void batchMinIndex(const double* d, int index, double* best, int* labels, size_t n)
+{
+    batchMinIndexSimd<double>(d, index, best, labels, n);
+}
+
+// vector overloads, so that the kernels below can use the same utility on vectors and scalars
+SIMD_VECTOR(float) squareRoot(SIMD_VECTOR(float) value)
+{
+    return simdSqrt<float>(value);
+}
+
+SIMD_VECTOR(double) squareRoot(SIMD_VECTOR(double) value)
+{
+    return simdSqrt<double>(value);
+}
+
+SIMD_VECTOR(float) fmaValue(SIMD_VECTOR(float) a, float b, SIMD_VECTOR(float) c)
+{
+    return a * b + c;
+}
+
+SIMD_VECTOR(double) fmaValue(SIMD_VECTOR(double) a, double b, SIMD_VECTOR(double) c)
+{
+    return a * b + c;
+}
+
+#endif
+
+template<typename T>
+void batchAdd(const T* a, const T* b, T* dst, size_t n)
+{
+    batchApply(a, b, dst, n, [](auto x, auto y) { return x + y; });
+}
+
+template<typename T>
+void batchAdd(const T* a, T b, T* dst, size_t n)
+{
+    batchApply(a, a, dst, n, [b](auto x, auto) { return x + b; });
+}
+
+template<typename T>
+void batchSub(const T* a, const T* b, T* dst, size_t n)
+{
+    batchApply(a, b, dst, n, [](auto x, auto y) { return x - y; });
+}
+
+template<typename T>
+void batchSub(const T* a, T b, T* dst, size_t n)
+{
+    batchApply(a, a, dst, n, [b](auto x, auto) { return x - b; });
+}
+
+template<typename T>
+void batchMul(const T* a, const T* b, T* dst, size_t n)
+{
+    batchApply(a, b, dst, n, [](auto x, auto y) { return x * y; });
+}
+
+template<typename T>
+void batchMul(const T* a, T b, T* dst, size_t n)
+{
+    batchApply(a, a, dst, n, [b](auto x, auto) { return x * b; });
+}
+
+template<typename T>
+void batchDiv(const T* a, const T* b, T* dst, size_t n)
+{
+    batchApply(a, b, dst, n, [](auto x, auto y) { return x / y; });
+}
+
+template<typename T>
+void batchDiv(const T* a, T b, T* dst, size_t n)
+{
+    batchApply(a, a, dst, n, [b](auto x, auto) { return x / b; });
+}
+
+// dst[i] = a[i] * b + c[i], with fmaValue so that LNS types skip the additions of zero terms
+template<typename T>
+void batchMulAdd(const T* a, T b, const T* c, T* dst, size_t n)
+{
+    batchApply(a, c, dst, n, [b](auto x, auto y) { return fmaValue(x, b, y); });
+}
+
+// dst[i] = (r[i] - x)^2 + (g[i] - y)^2 + (b[i] - z)^2
+template<typename T>
+void batchSquaredDistance(const T* r, const T* g, const T* b, T x, T y, T z, T* dst, size_t n)
+{
+    batchApply3(r, g, b, dst, n, [x, y, z](auto p, auto q, auto s) { return square(p - x) + square(q - y) + square(s - z); });
+}
+
+template<typename T>
+void batchSqrt(const T* a, T* dst, size_t n)
+{
+    batchApply(a, a, dst, n, [](auto x, auto) { return squareRoot(x); });
+}
+
+template<typename T>
+void batchSquare(const T* a, T* dst, size_t n)
+{
+    batchApply(a, a, dst, n, [](auto x, auto) { return square(x); });
+}
+
+#endif
@@ -11,6 +11,12 @@
 #include <vector>
 #include <iostream>
 #include <iomanip>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include "utilities.hpp"
+#include "reduction.hpp"
+#include "counting.hpp"
 
 template<typename T, int N>
 void saxpy()
@@ -30,12 +36,64 @@ void saxpy()
     auto startTime = std::chrono::steady_clock::now();
 
     for(int i = 0; i < N; ++i)
-        y[i] = a * x[i] + y[i];
+        y[i] = fmaValue(a, x[i], y[i]);
 
     auto endTime = std::chrono::steady_clock::now();
     std::cout << "Saxpy time: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << " ms" << std::endl;
 }
 
+// times a unary function over the given inputs and returns the results
+template<typename T, typename Function>
+std::vector<T> timeUnaryFunction(const std::string& name, const std::vector<T>& inputs, const Function& function)
+{
+    std::vector<T> results(inputs.size());
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < inputs.size(); ++i)
+        results[i] = function(inputs[i]);
+
+    auto endTime = std::chrono::steady_clock::now();
+    std::cout << name << " time: " << std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count() << " us" << std::endl;
+    return results;
+}
+
+// compares the trigonometric utilities of T to a conversion through double and the libm call
+template<typename T, int N>
+void trigonometry()
+{
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> angleDistribution(-M_PI, M_PI);
+    std::uniform_real_distribution<double> unitDistribution(-1.0, 1.0);
+    std::vector<T> angles, units;
+    angles.reserve(N);
+    units.reserve(N);
+    for(int i = 0; i < N; ++i)
+    {
+        angles.emplace_back(angleDistribution(generator));
+        units.emplace_back(unitDistribution(generator));
+    }
+
+    auto sinUtility = timeUnaryFunction("sinValue", angles, [](T x) { return sinValue(x); });
+    auto sinConversion = timeUnaryFunction("sin through double", angles, [](T x) { return T(std::sin((double)x)); });
+    auto cosUtility = timeUnaryFunction("cosValue", angles, [](T x) { return cosValue(x); });
+    auto cosConversion = timeUnaryFunction("cos through double", angles, [](T x) { return T(std::cos((double)x)); });
+    auto asinUtility = timeUnaryFunction("asinValue", units, [](T x) { return asinValue(x); });
+    auto asinConversion = timeUnaryFunction("asin through double", units, [](T x) { return T(std::asin((double)x)); });
+    auto acosUtility = timeUnaryFunction("acosValue", units, [](T x) { return acosValue(x); });
+    auto acosConversion = timeUnaryFunction("acos through double", units, [](T x) { return T(std::acos((double)x)); });
+
+    double maxError = 0.0;
+    for(int i = 0; i < N; ++i)
+    {
+        maxError = std::max(maxError, std::fabs((double)sinUtility[i] - (double)sinConversion[i]));
+        maxError = std::max(maxError, std::fabs((double)cosUtility[i] - (double)cosConversion[i]));
+        maxError = std::max(maxError, std::fabs((double)asinUtility[i] - (double)asinConversion[i]));
+        maxError = std::max(maxError, std::fabs((double)acosUtility[i] - (double)acosConversion[i]));
+    }
+    std::cout << std::setprecision(10) << "Maximum absolute difference: " << maxError << std::endl;
+}
+
 double error(double value1, double value2)
 {
 	if(std::isnan(value1) || std::isnan(value2))
@@ -53,6 +111,87 @@ double error(double value1, double value2)
     return fabs(value1 - value2) / std::max(fabs(value1), fabs(value2));
 }
 
+// compares the exponential and natural logarithm utilities of T to a conversion through double
+// and the libm call, on arguments in the ranges of Black-Scholes
+template<typename T, int N>
+void exponential()
+{
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> exponentDistribution(-10.0, 2.0);
+    std::uniform_real_distribution<double> ratioDistribution(0.5, 2.0);
+    std::vector<T> exponents, ratios;
+    exponents.reserve(N);
+    ratios.reserve(N);
+    for(int i = 0; i < N; ++i)
+    {
+        exponents.emplace_back(exponentDistribution(generator));
+        ratios.emplace_back(ratioDistribution(generator));
+    }
+
+    auto expUtility = timeUnaryFunction("expValue", exponents, [](T x) { return expValue(x); });
+    auto expConversion = timeUnaryFunction("exp through double", exponents, [](T x) { return T(std::exp((double)x)); });
+    auto logUtility = timeUnaryFunction("naturalLog", ratios, [](T x) { return naturalLog(x); });
+    auto logConversion = timeUnaryFunction("log through double", ratios, [](T x) { return T(std::log((double)x)); });
+
+    double maxError = 0.0;
+    for(int i = 0; i < N; ++i)
+    {
+        maxError = std::max(maxError, error((double)expUtility[i], (double)expConversion[i]));
+        maxError = std::max(maxError, error((double)logUtility[i], (double)logConversion[i]));
+    }
+    std::cout << std::setprecision(10) << "Maximum relative difference: " << 100.0 * maxError << "%" << std::endl;
+}
+
+// times sums of Block values and 3-element dot products of T, accumulated term by term or
+// with deferred summation, and reports their relative errors to the exact double results
+template<typename T, int N, int Block>
+void reductionStrategy(const std::string& name, const std::vector<double>& values, bool deferred)
+{
+    std::vector<T> inputs(values.begin(), values.end());
+    std::vector<T> sums(N / Block), dots(N / 3);
+
+    auto startTime = std::chrono::steady_clock::now();
+    for(int i = 0; i < N / Block; ++i)
+        sums[i] = deferred ? sum<T, true>(&inputs[i * Block], Block) : sum<T, false>(&inputs[i * Block], Block);
+    auto middleTime = std::chrono::steady_clock::now();
+    for(int i = 0; i < N / 3; ++i)
+        dots[i] = deferred ? dot<3, T, true>(&inputs[i * 3], &inputs[(N / 3 - 1 - i) * 3]) : dot<3, T, false>(&inputs[i * 3], &inputs[(N / 3 - 1 - i) * 3]);
+    auto endTime = std::chrono::steady_clock::now();
+
+    double maxSumError = 0.0, maxDotError = 0.0;
+    for(int i = 0; i < N / Block; ++i)
+    {
+        double exact = 0.0;
+        for(int j = 0; j < Block; ++j)
+            exact += (double)inputs[i * Block + j];
+        maxSumError = std::max(maxSumError, error((double)sums[i], exact));
+    }
+    for(int i = 0; i < N / 3; ++i)
+    {
+        double exact = 0.0;
+        for(int j = 0; j < 3; ++j)
+            exact += (double)inputs[i * 3 + j] * (double)inputs[(N / 3 - 1 - i) * 3 + j];
+        maxDotError = std::max(maxDotError, error((double)dots[i], exact));
+    }
+
+    std::cout << name << " sum time: " << std::chrono::duration_cast<std::chrono::microseconds>(middleTime - startTime).count() << " us, maximum error: " << std::setprecision(10) << 100.0 * maxSumError << "%" << std::endl;
+    std::cout << name << " dot time: " << std::chrono::duration_cast<std::chrono::microseconds>(endTime - middleTime).count() << " us, maximum error: " << std::setprecision(10) << 100.0 * maxDotError << "%" << std::endl;
+}
+
+template<typename T, int N>
+void reduction()
+{
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> distribution(0.0, 1000.0);
+    std::vector<double> values;
+    values.reserve(N);
+    for(int i = 0; i < N; ++i)
+        values.emplace_back(distribution(generator));
+
+    reductionStrategy<T, N, 64>("Term by term", values, false);
+    reductionStrategy<T, N, 64>("Deferred", values, true);
+}
+
 // compare generic vectors of floats
 void printVectorError(const std::vector<float>& values1, const std::vector<float>& values2)
 {
@@ -136,6 +275,36 @@ void printVectorError(const std::vector<bool>& values1, const std::vector<bool>&
     std::cout << "Accuracy: " << accuracy << "%" << std::endl;
 }
 
+// error statistics of two images, accumulated pixel by pixel so that images can be compared
+// as they are produced, without being stored
+struct ImageError
+{
+    size_t values = 0;
+    double meanAbsError = 0, maxAbsError = 0, meanSqError = 0;
+
+    // adds a pixel given by its 3 channels in each image
+    void add(const int* pixel1, const int* pixel2)
+    {
+        double sqError = 0.0;
+        for(int j = 0; j < 3; ++j)
+            sqError += (pixel1[j] - pixel2[j]) * (pixel1[j] - pixel2[j]);
+
+        meanSqError += sqError;
+        double error = sqrt(sqError);
+        meanAbsError += error;
+        maxAbsError = std::max(maxAbsError, error);
+        values += 3;
+    }
+
+    void print() const
+    {
+        std::cout << std::setprecision(10);
+        std::cout << "Maximum absolute error: " << maxAbsError << std::endl;
+        std::cout << "Mean absolute error: " << meanAbsError / values << std::endl;
+        std::cout << "Root-mean-square error: " << sqrt(meanSqError / values) << std::endl;
+    }
+};
+
 // to compare images (3 adjacent ints correspond to 1 pixel)
 void printVectorError(const std::vector<int>& values1, const std::vector<int>& values2)
 {
@@ -150,25 +319,18 @@ void printVectorError(const std::vector<int>& values1, const std::vector<int>& v
         return;
     }
 
-    double meanAbsError = 0, maxAbsError = 0, meanSqError = 0;
+    ImageError imageError;
     for(size_t i = 0; i < values1.size(); i += 3)
-    {
-        double sqError = 0.0;
-        for(size_t j = i; j < i + 3; ++j)
-            sqError += (values1[j] - values2[j]) * (values1[j] - values2[j]);
-
-        meanSqError += sqError;
-        double error = sqrt(sqError);
-        meanAbsError += error;
-        maxAbsError = std::max(maxAbsError, error);
-    }
-    meanAbsError /= values1.size();
-    meanSqError /= values1.size();
+        imageError.add(&values1[i], &values2[i]);
+    imageError.print();
+}
 
+// report the throughput of a timed section of a benchmark
+void printThroughput(const std::string& name, double count, const std::string& unit, long long int microseconds)
+{
     std::cout << std::setprecision(10);
-    std::cout << "Maximum absolute error: " << maxAbsError << std::endl;
-    std::cout << "Mean absolute error: " << meanAbsError << std::endl;
-    std::cout << "Root-mean-square error: " << sqrt(meanSqError) << std::endl;
+    std::cout << name << ": " << (count * 1e6 / std::max(microseconds, 1LL)) << " " << unit << "/s ("
+              << (microseconds / 1000.0) << " ms)" << std::endl;
 }
 
 void printTimeDifference(long long int time1, long long int time2)
@@ -182,15 +344,24 @@ void printTimeDifference(long long int time1, long long int time2)
 template<typename F1, typename F2, typename Param>
 void runBenchmark(const F1& f1, const F2& f2, const Param& param)
 {
+    // operation counts are only recorded when a type is a counting_t
+    OperationCountRegistry::get().reset();
     auto start = std::chrono::steady_clock::now();
     auto values1 = f1(param);
     auto time1 = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    OperationCounts counts1 = OperationCountRegistry::get().total();
 
+    OperationCountRegistry::get().reset();
     start = std::chrono::steady_clock::now();
     auto values2 = f2(param);
     auto time2 = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    OperationCounts counts2 = OperationCountRegistry::get().total();
 
     printTimeDifference(time1, time2);
+    printOperationCounts("the reference type", counts1);
+    printOperationCounts("the benchmarked type", counts2);
+    if(lnsTableMemory() > 0)
+        std::cout << "LNS lookup table memory: " << (lnsTableMemory() / 1024.0) << " KiB" << std::endl;
     printVectorError(values1, values2);
     std::cout << std::endl;
 }
@@ -16,35 +16,53 @@
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include <chrono>
+#include <algorithm>
 #include "../lns.hpp"
 #include "utilities.hpp"
+#include "threading.hpp"
+#include "benchmarks.hpp"
+#include "simd.hpp"
+#include "batch.hpp"
 
 #define DIVIDE 120.0
 
+// number of times the whole option set is priced, for longer steady-state measurements
+#ifndef NUM_RUNS
 #define NUM_RUNS 1
+#endif
 
-template<typename T>
-struct OptionData {
-    T s;          // spot price
-    T strike;     // strike price
-    T r;          // risk-free interest rate
-    T divq;       // dividend rate
-    T v;          // volatility
-    T t;          // time to maturity or option expiration in years
-    //     (1yr = 1.0, 6mos = 0.5, 3mos = 0.25, ..., etc)
-    char OptionType;   // Option type.  "P"=PUT, "C"=CALL
-    T divs;       // dividend vals (not used in this test)
-    T DGrefval;   // DerivaGem Reference Value
-};
+#define PAD 256
+#define LINESIZE 64
+
+// options are distributed to the threads in chunks spanning this many cache lines of each array
+#define CHUNK_LINES 16
+
+// number of options whose d1 and d2 are computed together by the batch kernels
+#define BATCH_SIZE 64
+
+// Each line of the input file describes one option:
+//     s          spot price
+//     strike     strike price
+//     r          risk-free interest rate
+//     divq       dividend rate (not used in this test)
+//     v          volatility
+//     t          time to maturity or option expiration in years
+//                (1yr = 1.0, 6mos = 0.5, 3mos = 0.25, ..., etc)
+//     OptionType "P"=PUT, "C"=CALL
+//     divs       dividend vals (not used in this test)
+//     DGrefval   DerivaGem Reference Value (not used in this test)
+// The used fields are parsed directly into the arrays of GlobalData, the others are skipped.
 
 template <typename T>
 struct GlobalData
 {
-    OptionData<T> *data;
     T *prices;
     int numOptions;
+    int nThreads;
+    int chunkSize;
 
-    int    * otype;
+    unsigned char * otype;    // 1 for a put, 0 for a call
     T * sptprice;
     T * strike;
     T * rate;
@@ -61,6 +79,15 @@ struct GlobalData
 // See Hull, Section 11.8, P.243-244
 #define inv_sqrt_2xPI 0.39894228040143270286
 
+// constants of the formulas, converted once per type before main instead of at every call
+template<typename T> const T bsOne = T(1.0);
+template<typename T> const T bsHalf = T(0.5);
+template<typename T> const T bsMinusHalf = T(-0.5);
+template<typename T> const T bsInvSqrt2xPI = T(inv_sqrt_2xPI);
+template<typename T> const T bsCNDFScale = T(0.2316419);
+template<typename T> const T bsCNDFCoeffs[5] = { T(0.319381530), T(-0.356563782), T(1.781477937),
+                                                 T(-1.821255978), T(1.330274429) };
+
 template<typename T>
 T CNDF ( T InputX )
 {
@@ -71,10 +98,7 @@ T CNDF ( T InputX )
     T xNPrimeofX;
     T expValues;
     T xK2;
-    T xK2_2, xK2_3;
-    T xK2_4, xK2_5;
-    T xLocal, xLocal_1;
-    T xLocal_2, xLocal_3;
+    T xLocal;
 
     // Check for negative value of InputX
     if (isNegative(InputX)) {
@@ -86,42 +110,30 @@ T CNDF ( T InputX )
     xInput = InputX;
 
     // Compute NPrimeX term common to both four & six decimal accuracy calcs
-    expValues = (T) exp((double)(T(-0.5) * square(InputX)));
+    expValues = expValue(bsMinusHalf<T> * square(InputX));
     xNPrimeofX = expValues;
-    xNPrimeofX = xNPrimeofX * T(inv_sqrt_2xPI);
-
-    xK2 = T(0.2316419) * xInput;
-    xK2 = T(1.0) + xK2;
-    xK2 = T(1.0) / xK2;
-    xK2_2 = square(xK2);
-    xK2_3 = xK2_2 * xK2;
-    xK2_4 = xK2_3 * xK2;
-    xK2_5 = xK2_4 * xK2;
-
-    xLocal_1 = xK2 * T(0.319381530);
-    xLocal_2 = xK2_2 * T(-0.356563782);
-    xLocal_3 = xK2_3 * T(1.781477937);
-    xLocal_2 += xLocal_3;
-    xLocal_3 = xK2_4 * T(-1.821255978);
-    xLocal_2 += xLocal_3;
-    xLocal_3 = xK2_5 * T(1.330274429);
-    xLocal_2 += xLocal_3;
-
-    xLocal_1 += xLocal_2;
-    xLocal   = xLocal_1 * xNPrimeofX;
+    xNPrimeofX = xNPrimeofX * bsInvSqrt2xPI<T>;
+
+    xK2 = bsCNDFScale<T> * xInput;
+    xK2 = bsOne<T> + xK2;
+    xK2 = bsOne<T> / xK2;
+
+    // polynomial in xK2 in Horner form, no powers of xK2 are needed
+    xLocal   = xK2 * hornerValue(xK2, bsCNDFCoeffs<T>);
+    xLocal   = xLocal * xNPrimeofX;
 
     //printf("# xLocal: %10.10f\n", xLocal);
 
 
 
-    xLocal   = T(1.0) - xLocal;
+    xLocal   = bsOne<T> - xLocal;
 
     OutputX  = xLocal;
 
     //printf("# Output: %10.10f\n", OutputX);
 
     if (sign) {
-        OutputX = T(1.0) - OutputX;
+        OutputX = bsOne<T> - OutputX;
     }
 
     return OutputX;
@@ -132,97 +144,166 @@ T CNDF ( T InputX )
 //////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////
 
+// price of an option from d1 and d2, which priceOptions computes for batches of options
 template<typename T>
 T BlkSchlsEqEuroNoDiv( T sptprice,
-                            T strike, T rate, T volatility,
-                            T time, int otype)
+                            T strike, T rate,
+                            T time, T d1, T d2, int otype)
 {
     T OptionPrice;
 
     // local private working variables for the calculation
-    //fptype xStockPrice;
-    //fptype xStrikePrice;
-    T xRiskFreeRate;
-    T xVolatility;
-    T xTime;
-    T xSqrtTime;
-
-    T logValues;
-    T xLogTerm;
-    T xD1;
-    T xD2;
-    T xPowerTerm;
-    T xDen;
-    T d1;
-    T d2;
     T FutureValueX;
     T NofXd1;
     T NofXd2;
     T NegNofXd1;
     T NegNofXd2;
 
-    //xStockPrice = sptprice;
-    //xStrikePrice = strike;
-    xRiskFreeRate = rate;
-    xVolatility = volatility;
-    xTime = time;
+    NofXd1 = CNDF( d1 );
+    NofXd2 = CNDF( d2 );
 
+    FutureValueX = strike * expValue( -(rate)*(time) );
+    if (otype == 0) {
+        OptionPrice = (sptprice * NofXd1) - (FutureValueX * NofXd2);
 
-    xSqrtTime = squareRoot(xTime);
+    } else {
+        NegNofXd1 = (bsOne<T> - NofXd1);
+        NegNofXd2 = (bsOne<T> - NofXd2);
+        OptionPrice = (FutureValueX * NegNofXd2) - (sptprice * NegNofXd1);
+    }
 
-    logValues = naturalLog( sptprice / strike );
+    return OptionPrice;
+}
 
-    xLogTerm = logValues;
+// prices the options in [start, end), the arithmetic of d1 and d2 runs on batches of options
+// with the batch kernels
+template<typename T>
+void priceOptions(GlobalData<T>& globalData, int start, int end) {
+    T xSqrtTime[BATCH_SIZE], xLogTerm[BATCH_SIZE], xPowerTerm[BATCH_SIZE];
+    T xDen[BATCH_SIZE], xD1[BATCH_SIZE], xD2[BATCH_SIZE];
+    int i, j, n;
 
+    for (i=start; i<end; i+=BATCH_SIZE) {
+        n = std::min(BATCH_SIZE, end - i);
 
-    xPowerTerm = square(xVolatility);
-    xPowerTerm = xPowerTerm * T(0.5);
+        batchSqrt(globalData.otime + i, xSqrtTime, n);
 
-    xD1 = xRiskFreeRate + xPowerTerm;
-    xD1 = xD1 * xTime;
-    xD1 = xD1 + xLogTerm;
+        batchDiv(globalData.sptprice + i, globalData.strike + i, xLogTerm, n);
+        for (j=0; j<n; j++)
+            xLogTerm[j] = naturalLog(xLogTerm[j]);
 
-    xDen = xVolatility * xSqrtTime;
-    xD1 = xD1 / xDen;
-    xD2 = xD1 -  xDen;
+        batchSquare(globalData.volatility + i, xPowerTerm, n);
+        batchMul(xPowerTerm, bsHalf<T>, xPowerTerm, n);
 
-    d1 = xD1;
-    d2 = xD2;
+        batchAdd(globalData.rate + i, xPowerTerm, xD1, n);
+        batchMul(xD1, globalData.otime + i, xD1, n);
+        batchAdd(xD1, xLogTerm, xD1, n);
 
-    NofXd1 = CNDF( d1 );
-    NofXd2 = CNDF( d2 );
+        batchMul(globalData.volatility + i, xSqrtTime, xDen, n);
+        batchDiv(xD1, xDen, xD1, n);
+        batchSub(xD1, xDen, xD2, n);
 
-    FutureValueX = strike * (T) ( exp( (double) (-(rate)*(time)) ) );
-    if (otype == 0) {
-        OptionPrice = (sptprice * NofXd1) - (FutureValueX * NofXd2);
+        for (j=0; j<n; j++)
+            globalData.prices[i + j] = BlkSchlsEqEuroNoDiv(globalData.sptprice[i + j], globalData.strike[i + j],
+                                                           globalData.rate[i + j], globalData.otime[i + j],
+                                                           xD1[j], xD2[j], globalData.otype[i + j]);
+    }
+}
 
-    } else {
-        NegNofXd1 = (T(1.0) - NofXd1);
-        NegNofXd2 = (T(1.0) - NofXd2);
-        OptionPrice = (FutureValueX * NegNofXd2) - (sptprice * NegNofXd1);
+#ifndef NO_SIMD
+
+// vector versions for float and double, pricing SIMD_WIDTH(S) options at once
+
+template<typename S>
+SIMD_VECTOR(S) CNDFSimd(SIMD_VECTOR(S) InputX)
+{
+    typedef SIMD_VECTOR(S) V;
+
+    // the polynomial is evaluated on |x| and mirrored for negative inputs without branching
+    V xInput = simdAbs<S>(InputX);
+    V xNPrimeofX = simdExp<S>(simdSplat<S>(-0.5) * xInput * xInput) * simdSplat<S>(inv_sqrt_2xPI);
+
+    V xK2 = simdSplat<S>(1.0) / (simdSplat<S>(1.0) + simdSplat<S>(0.2316419) * xInput);
+    V xLocal = simdSplat<S>(1.330274429);
+    xLocal = simdSplat<S>(-1.821255978) + xK2 * xLocal;
+    xLocal = simdSplat<S>(1.781477937) + xK2 * xLocal;
+    xLocal = simdSplat<S>(-0.356563782) + xK2 * xLocal;
+    xLocal = simdSplat<S>(0.319381530) + xK2 * xLocal;
+    xLocal = xK2 * xLocal * xNPrimeofX;
+
+    V OutputX = simdSplat<S>(1.0) - xLocal;
+    return simdBlend<S>(InputX < simdSplat<S>(0.0), xLocal, OutputX);
+}
+
+template<typename S>
+SIMD_VECTOR(S) BlkSchlsEqEuroNoDivSimd(SIMD_VECTOR(S) sptprice, SIMD_VECTOR(S) strike, SIMD_VECTOR(S) rate,
+                                        SIMD_VECTOR(S) volatility, SIMD_VECTOR(S) time, SIMD_MASK(S) isPut)
+{
+    typedef SIMD_VECTOR(S) V;
+
+    V xSqrtTime = simdSqrt<S>(time);
+    V xLogTerm = simdLog<S>(sptprice / strike);
+    V xPowerTerm = volatility * volatility * simdSplat<S>(0.5);
+
+    V xDen = volatility * xSqrtTime;
+    V xD1 = ((rate + xPowerTerm) * time + xLogTerm) / xDen;
+    V xD2 = xD1 - xDen;
+
+    V NofXd1 = CNDFSimd<S>(xD1);
+    V NofXd2 = CNDFSimd<S>(xD2);
+
+    V FutureValueX = strike * simdExp<S>(-rate * time);
+    V callPrice = (sptprice * NofXd1) - (FutureValueX * NofXd2);
+    V putPrice = (FutureValueX * (simdSplat<S>(1.0) - NofXd2)) - (sptprice * (simdSplat<S>(1.0) - NofXd1));
+
+    return simdBlend<S>(isPut, putPrice, callPrice);
+}
+
+template<typename S>
+void priceOptionsSimd(GlobalData<S>& globalData, int start, int end) {
+    const int width = SIMD_WIDTH(S);
+    SIMD_MASK(S) isPut = {};
+    int i, j;
+
+    for (i=start; i + width <= end; i += width) {
+        for (j=0; j<width; j++)
+            isPut[j] = -(globalData.otype[i + j] != 0);
+
+        simdStore<S>(globalData.prices + i,
+                     BlkSchlsEqEuroNoDivSimd<S>(simdLoad<S>(globalData.sptprice + i), simdLoad<S>(globalData.strike + i),
+                                                simdLoad<S>(globalData.rate + i), simdLoad<S>(globalData.volatility + i),
+                                                simdLoad<S>(globalData.otime + i), isPut));
     }
 
-    return OptionPrice;
+    // remaining options
+    priceOptions<S>(globalData, i, end);
+}
+
+void priceOptions(GlobalData<float>& globalData, int start, int end) {
+    priceOptionsSimd<float>(globalData, start, end);
+}
+
+void priceOptions(GlobalData<double>& globalData, int start, int end) {
+    priceOptionsSimd<double>(globalData, start, end);
 }
 
+#endif
+
 template<typename T>
 int bs_thread(void *tid_ptr, GlobalData<T>& globalData) {
-    int i, j;
+    int j;
 
     int tid = *(int *)tid_ptr;
-    int start = tid * (globalData.numOptions);
-    int end = start + (globalData.numOptions);
-    T price_orig;
+    int start, end;
 
     for (j=0; j<NUM_RUNS; j++) {
-        for (i=start; i<end; i++) {
-            /* Calling main function to calculate option value based on
-             * Black & Scholes's equation.
-             */
-            price_orig = BlkSchlsEqEuroNoDiv( globalData.sptprice[i], globalData.strike[i],
-                                              globalData.rate[i], globalData.volatility[i], globalData.otime[i],
-                                              globalData.otype[i]);
-            globalData.prices[i] = price_orig;
+        // chunks are distributed cyclically; every array starts on a cache line and a chunk
+        // spans whole lines of each of them when sizeof(T) divides the line size, so that no
+        // two threads write to the same line of prices
+        for (start = tid * globalData.chunkSize; start < globalData.numOptions;
+             start += globalData.nThreads * globalData.chunkSize) {
+            end = std::min(start + globalData.chunkSize, globalData.numOptions);
+            priceOptions(globalData, start, end);
         }
     }
     return 0;
@@ -234,11 +315,11 @@ std::vector<float> blackscholes(const std::string& inputFileName)
     GlobalData<T> globalData;
 
     int i;
-    int loopnum;
+    size_t stride;
     T * buffer;
-    int * buffer2;
-
-    std::vector<float> output;
+    unsigned char * buffer2;
+    T * buffer3;
+    char optionType;
 
     //Read input data from file
     std::ifstream file(inputFileName);
@@ -249,58 +330,61 @@ std::vector<float> blackscholes(const std::string& inputFileName)
 
     file >> globalData.numOptions;
 
-    // alloc spaces for the option data
-    globalData.data = (OptionData<T>*)malloc(globalData.numOptions*sizeof(OptionData<T>));
-    globalData.prices = (T*)malloc(globalData.numOptions*sizeof(T));
-    for ( loopnum = 0; loopnum < globalData.numOptions; ++ loopnum )
-    {
-        readFromStream(file, globalData.data[loopnum].s);
-        readFromStream(file, globalData.data[loopnum].strike);
-        readFromStream(file, globalData.data[loopnum].r);
-        readFromStream(file, globalData.data[loopnum].divq);
-        readFromStream(file, globalData.data[loopnum].v);
-        readFromStream(file, globalData.data[loopnum].t);
-        file >> globalData.data[loopnum].OptionType;
-        readFromStream(file, globalData.data[loopnum].divs);
-        readFromStream(file, globalData.data[loopnum].DGrefval);
-    }
-
-#define PAD 256
-#define LINESIZE 64
-
-    buffer = (T *) malloc(5 * globalData.numOptions * sizeof(T) + PAD);
+    // alloc spaces for the option data, each array starts on a cache line
+    stride = (globalData.numOptions * sizeof(T) + LINESIZE - 1) & ~(size_t)(LINESIZE - 1);
+    buffer = (T *) malloc(5 * stride + PAD);
     globalData.sptprice = (T *) (((unsigned long long)buffer + PAD) & ~(LINESIZE - 1));
-    globalData.strike = globalData.sptprice + globalData.numOptions;
-    globalData.rate = globalData.strike + globalData.numOptions;
-    globalData.volatility = globalData.rate + globalData.numOptions;
-    globalData.otime = globalData.volatility + globalData.numOptions;
+    globalData.strike = (T *) ((char *)globalData.sptprice + stride);
+    globalData.rate = (T *) ((char *)globalData.strike + stride);
+    globalData.volatility = (T *) ((char *)globalData.rate + stride);
+    globalData.otime = (T *) ((char *)globalData.volatility + stride);
 
-    buffer2 = (int *) malloc(globalData.numOptions * sizeof(T) + PAD);
-    globalData.otype = (int *) (((unsigned long long)buffer2 + PAD) & ~(LINESIZE - 1));
+    buffer2 = (unsigned char *) malloc(globalData.numOptions * sizeof(unsigned char) + PAD);
+    globalData.otype = (unsigned char *) (((unsigned long long)buffer2 + PAD) & ~(LINESIZE - 1));
+
+    buffer3 = (T *) malloc(globalData.numOptions * sizeof(T) + PAD);
+    globalData.prices = (T *) (((unsigned long long)buffer3 + PAD) & ~(LINESIZE - 1));
 
     T divide(DIVIDE);
     for (i=0; i<globalData.numOptions; i++) {
-        globalData.otype[i]      = (globalData.data[i].OptionType == 'P') ? 1 : 0;
-        globalData.sptprice[i]   = globalData.data[i].s / divide;
-        globalData.strike[i]     = globalData.data[i].strike / divide;
-        globalData.rate[i]       = globalData.data[i].r;
-        globalData.volatility[i] = globalData.data[i].v;
-        globalData.otime[i]      = globalData.data[i].t;
+        readFromStream(file, globalData.sptprice[i]);
+        readFromStream(file, globalData.strike[i]);
+        readFromStream(file, globalData.rate[i]);
+        skipField(file);    // divq
+        readFromStream(file, globalData.volatility[i]);
+        readFromStream(file, globalData.otime[i]);
+        file >> optionType;
+        skipField(file);    // divs
+        skipField(file);    // DGrefval
+
+        globalData.otype[i]      = (optionType == 'P') ? 1 : 0;
     }
+    batchDiv(globalData.sptprice, divide, globalData.sptprice, globalData.numOptions);
+    batchDiv(globalData.strike, divide, globalData.strike, globalData.numOptions);
+
+    globalData.nThreads = getThreadCount();
+    globalData.chunkSize = CHUNK_LINES * std::max<int>(1, LINESIZE / sizeof(T));
 
-    //serial version
-    int tid=0;
-    bs_thread<T>(&tid, globalData);
+    auto startTime = std::chrono::steady_clock::now();
 
+    runThreads(globalData.nThreads, [&globalData](int tid) {
+        bs_thread<T>(&tid, globalData);
+    });
 
+    auto endTime = std::chrono::steady_clock::now();
+    printThroughput("Pricing throughput on " + std::to_string(globalData.nThreads) + " thread(s)",
+                    (double)globalData.numOptions * NUM_RUNS, "options",
+                    std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
+
+
+    std::vector<float> output;
     for(i=0; i<globalData.numOptions; i++) {
         output.push_back((float)globalData.prices[i]);
     }
 
-    free(globalData.data);
-    free(globalData.prices);
     free(buffer);
     free(buffer2);
+    free(buffer3);
 
     return output;
 }
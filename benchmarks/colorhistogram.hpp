@@ -0,0 +1,197 @@
+#ifndef COLORHISTOGRAM_HPP
+#define COLORHISTOGRAM_HPP
+
+// Distinct colors of an 8-bit image with the number of pixels of each, so that k-means assigns
+// and recenters each color once, weighted by its count, instead of each pixel. Images have far
+// fewer colors than pixels, so the arithmetic per iteration shrinks accordingly. The colors are
+// stored as planes like the images, and each pixel keeps the index of its color so that the
+// labels are mapped back to the pixels at the end.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "rgbimage.hpp"
+#include "segmentation.hpp"
+#include "batch.hpp"
+#include "threading.hpp"
+
+template<typename T>
+struct ColorHistogram {
+    int width = 0;
+    int height = 0;
+    std::vector<T> r;               // distinct colors, divided by scale
+    std::vector<T> g;
+    std::vector<T> b;
+    std::vector<int> counts;        // pixels of each color
+    std::vector<T> weights;         // counts converted once
+    std::vector<int> labels;
+    std::vector<T> distances;
+    std::vector<int> colorIndex;    // color of each pixel
+};
+
+// loads an image as its distinct colors, sorted by 0xRRGGBB value, and returns 0 when the file
+// cannot be read or a channel is outside of [0, 255]
+template<typename T>
+int loadColorHistogram(const char* fileName, ColorHistogram<T>* histogram, T scale) {
+    int c;
+    int i;
+    int value;
+    int width, height;
+    char w[256];
+    FILE *fp;
+
+    fp = fopen(fileName, "r");
+    if (!fp) {
+        printf("Warning: Oops! Cannot open %s!\n", fileName);
+        return 0;
+    }
+
+    c = readCell(fp, w);
+    width = atoi(w);
+    c = readCell(fp, w);
+    height = atoi(w);
+
+    if (width <= 0 || height <= 0) {
+        printf("Warning: Oops! Invalid image size %d x %d in %s!\n", width, height, fileName);
+        fclose(fp);
+        return 0;
+    }
+
+    size_t pixels = (size_t)width * height;
+    std::vector<uint32_t> keys(pixels);
+    for (size_t p = 0; p < pixels; p++) {
+        uint32_t key = 0;
+        for (c = 0; c < 3; c++) {
+            readCell(fp, w);
+            value = atoi(w);
+            if (value < 0 || value > 255) {
+                printf("Warning: Oops! Channel value %d out of [0, 255] in %s!\n", value, fileName);
+                fclose(fp);
+                return 0;
+            }
+            key = (key << 8) | (uint32_t)value;
+        }
+        keys[p] = key;
+    }
+    fclose(fp);
+
+    std::vector<uint32_t> colors(keys);
+    std::sort(colors.begin(), colors.end());
+    std::vector<int>& counts = histogram->counts;
+    counts.clear();
+    size_t m = 0;
+    for (size_t p = 0; p < pixels; p++) {
+        if (p == 0 || colors[p] != colors[m - 1]) {
+            colors[m++] = colors[p];
+            counts.push_back(0);
+        }
+        ++counts.back();
+    }
+    colors.resize(m);
+
+    histogram->width = width;
+    histogram->height = height;
+    histogram->colorIndex.resize(pixels);
+    for (size_t p = 0; p < pixels; p++)
+        histogram->colorIndex[p] = (int)(std::lower_bound(colors.begin(), colors.end(), keys[p]) - colors.begin());
+
+    // the channels of the colors are scaled like the pixels of an image
+    std::vector<T>* planes[3] = {&histogram->r, &histogram->g, &histogram->b};
+    for (c = 0; c < 3; c++) {
+        planes[c]->resize(m);
+        for (i = 0; i < (int)m; i++)
+            (*planes[c])[i] = T((int)((colors[i] >> (8 * (2 - c))) & 0xff));
+        batchDiv(planes[c]->data(), scale, planes[c]->data(), m);
+    }
+
+    histogram->weights.resize(m);
+    for (i = 0; i < (int)m; i++)
+        histogram->weights[i] = T(counts[i]);
+    histogram->labels.assign(m, 0);
+    histogram->distances.resize(m);
+    return 1;
+}
+
+// accumulates the colors [begin, end) into the sums of their clusters, weighted by their counts
+template<typename T>
+void accumulateColors(const ColorHistogram<T>& histogram, size_t begin, size_t end, ClusterSums<T>* partial) {
+    size_t i;
+    int c;
+
+    for (i = begin; i < end; i++) {
+        c = histogram.labels[i];
+        partial->sums[3 * c].add(histogram.r[i] * histogram.weights[i]);
+        partial->sums[3 * c + 1].add(histogram.g[i] * histogram.weights[i]);
+        partial->sums[3 * c + 2].add(histogram.b[i] * histogram.weights[i]);
+        partial->n[c] += histogram.counts[i];
+    }
+}
+
+// runs Lloyd iterations on the distinct colors until the largest centroid shift is below
+// threshold or n iterations are done, and returns the number of iterations; each thread
+// assigns a contiguous range of colors. distanceCount and converged are filled like in
+// segmentImage
+template<typename T>
+int segmentColors(ColorHistogram<T>* histogram, Clusters<T>* clusters, int n, double threshold, int nThreads,
+                  uint64_t* distanceCount = nullptr, bool* converged = nullptr) {
+    int i;
+    bool belowThreshold = false;
+    const size_t m = histogram->r.size();
+    const T squaredThreshold = square(T(threshold));
+
+    for (i = 0; i < n; ) {
+        std::vector<ClusterSums<T> > partial(nThreads, ClusterSums<T>(clusters->k));
+        runThreads(nThreads, [histogram, clusters, nThreads, m, &partial](int tid) {
+            size_t begin = m * tid / nThreads;
+            size_t end = m * (tid + 1) / nThreads;
+            if (begin == end)
+                return;
+            assignClusters(&histogram->r[begin], &histogram->g[begin], &histogram->b[begin],
+                           &histogram->labels[begin], &histogram->distances[begin], (int)(end - begin), clusters);
+            accumulateColors(*histogram, begin, end, &partial[tid]);
+            partial[tid].distances += (uint64_t)(end - begin) * clusters->k;
+        });
+
+        /** Recenter */
+        mergeSums(&partial);
+        if (distanceCount != nullptr)
+            *distanceCount += partial[0].distances;
+
+        T shift = recenter(clusters, partial[0]);
+
+        ++i;
+        if (shift < squaredThreshold) {
+            belowThreshold = true;
+            break;
+        }
+    }
+
+    if (converged != nullptr)
+        *converged = belowThreshold;
+    return i;
+}
+
+// exports the image with each pixel replaced by its centroid multiplied by scale, 3 adjacent
+// ints per pixel like exportRgbImage; each centroid is converted once
+template<typename T>
+std::vector<int> exportColorHistogram(const ColorHistogram<T>& histogram, const Clusters<T>& clusters, T scale) {
+    std::vector<int> centroids(3 * clusters.k);
+    for (int c = 0; c < clusters.k; c++) {
+        centroids[3 * c] = (int)(double)(clusters.centroids[c].r * scale);
+        centroids[3 * c + 1] = (int)(double)(clusters.centroids[c].g * scale);
+        centroids[3 * c + 2] = (int)(double)(clusters.centroids[c].b * scale);
+    }
+
+    std::vector<int> output(3 * histogram.colorIndex.size());
+    for (size_t p = 0; p < histogram.colorIndex.size(); p++) {
+        const int* centroid = &centroids[3 * histogram.labels[histogram.colorIndex[p]]];
+        output[3 * p] = centroid[0];
+        output[3 * p + 1] = centroid[1];
+        output[3 * p + 2] = centroid[2];
+    }
+    return output;
+}
+
+#endif
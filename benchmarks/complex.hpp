@@ -2,6 +2,7 @@
 #define COMPLEX_HPP
 
 #include <cmath>
+#include <cstdint>
 #include "utilities.hpp"
 
 template<typename T>
@@ -11,11 +12,133 @@ struct Complex
     T imag;
 };
 
+// Polar form, meant for LNS types: the magnitude of a lns_t is already stored as a logarithm,
+// so a complex multiplication is one magnitude multiplication and one phase addition.
+// The phase is a fixed-point fraction of a turn (2^32 units per turn): phase additions are
+// exact integer additions that wrap around, and FFT twiddle factors need no trigonometry.
+template<typename T>
+struct PolarComplex
+{
+    T magnitude;
+    uint32_t phase;
+};
+
+#define POLAR_HALF_TURN 0x80000000u
+#define POLAR_PHASE_TO_RADIANS (2 * M_PI / 4294967296.0)
+
+uint32_t phaseFromRadians(double angle)
+{
+    return (uint32_t)(int64_t)std::llround(angle / POLAR_PHASE_TO_RADIANS);
+}
+
+double phaseToRadians(uint32_t phase)
+{
+    // signed interpretation keeps the angle in [-PI, PI)
+    return (int32_t)phase * POLAR_PHASE_TO_RADIANS;
+}
+
+// phase of exp(-2 * i * PI * k / n), exact up to the phase resolution
+uint32_t fftTwiddlePhase(int k, int n)
+{
+    return (uint32_t)0 - (uint32_t)(((uint64_t)k << 32) / n);
+}
+
+template<typename T>
+PolarComplex<T> toPolar(const Complex<T>& c)
+{
+    PolarComplex<T> p;
+    p.magnitude = squareRoot(square(c.real) + square(c.imag));
+    p.phase = phaseFromRadians(std::atan2((double)c.imag, (double)c.real));
+    return p;
+}
+
+template<typename T>
+Complex<T> toCartesian(const PolarComplex<T>& p)
+{
+    double angle = phaseToRadians(p.phase);
+    Complex<T> c;
+    c.real = p.magnitude * T(std::cos(angle));
+    c.imag = p.magnitude * T(std::sin(angle));
+    return c;
+}
+
+template<typename T>
+PolarComplex<T> operator*(const PolarComplex<T>& a, const PolarComplex<T>& b)
+{
+    return {a.magnitude * b.magnitude, a.phase + b.phase};
+}
+
+template<typename T>
+PolarComplex<T> rotate(const PolarComplex<T>& p, uint32_t phase)
+{
+    return {p.magnitude, p.phase + phase};
+}
+
+template<typename T>
+PolarComplex<T> operator-(const PolarComplex<T>& p)
+{
+    return rotate(p, POLAR_HALF_TURN);
+}
+
+// Addition strategies for PolarComplex, each computes both a + b and a - b since
+// a butterfly always needs the pair (operands are copied, sum and diff may alias them)
+
+// convert both operands to Cartesian form, add there and convert back
+struct CartesianAddition
+{
+    template<typename T>
+    static void addSub(PolarComplex<T> a, PolarComplex<T> b, PolarComplex<T>* sum, PolarComplex<T>* diff)
+    {
+        Complex<T> ca = toCartesian(a);
+        Complex<T> cb = toCartesian(b);
+        *sum = toPolar<T>({ca.real + cb.real, ca.imag + cb.imag});
+        *diff = toPolar<T>({ca.real - cb.real, ca.imag - cb.imag});
+    }
+};
+
+// a +/- b = a * (1 +/- r * exp(i * theta)) with r = |b| / |a| and theta = phase(b) - phase(a):
+// the ratio and the phase difference are exact in the log domain, only the correction
+// factor goes through double, and the sum and difference share the same trigonometry
+struct RatioAddition
+{
+    template<typename T>
+    static void addSub(PolarComplex<T> a, PolarComplex<T> b, PolarComplex<T>* sum, PolarComplex<T>* diff)
+    {
+        if(isZero(b.magnitude))
+        {
+            *sum = *diff = a;
+            return;
+        }
+        if(isZero(a.magnitude))
+        {
+            *sum = b;
+            *diff = -b;
+            return;
+        }
+
+        // keep r <= 1, swapping the operands turns a - b into -(b - a)
+        bool swapped = b.magnitude > a.magnitude;
+        const PolarComplex<T>& big = swapped ? b : a;
+        const PolarComplex<T>& small = swapped ? a : b;
+
+        double r = (double)(small.magnitude / big.magnitude);
+        double theta = phaseToRadians(small.phase - big.phase);
+        double rc = r * std::cos(theta);
+        double rs = r * std::sin(theta);
+
+        sum->magnitude = big.magnitude * T(std::sqrt((1 + rc) * (1 + rc) + rs * rs));
+        sum->phase = big.phase + phaseFromRadians(std::atan2(rs, 1 + rc));
+        diff->magnitude = big.magnitude * T(std::sqrt((1 - rc) * (1 - rc) + rs * rs));
+        diff->phase = big.phase + phaseFromRadians(std::atan2(-rs, 1 - rc)) + (swapped ? POLAR_HALF_TURN : 0);
+    }
+};
+
+// converted once per type before main
+template<typename T> const T fftMinus2PI = T(-2 * M_PI);
+
 template<typename T>
 void fftSinCos(T x, T* s, T* c) {
-    static const T minus2PI(-2 * M_PI);
-    *s = sinValue(minus2PI * x);
-    *c = cosValue(minus2PI * x);
+    sinCosValue(fftMinus2PI<T> * x, s, c);
 }
 
 #endif
\ No newline at end of file
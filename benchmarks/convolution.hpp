@@ -0,0 +1,233 @@
+#ifndef CONVOLUTION_HPP
+#define CONVOLUTION_HPP
+
+// Convolution of the channels of an RGB image with square kernels of any odd size, built on the
+// loader, padded planes and row bands of Sobel. Kernels of rank one (box, Gaussian) are detected
+// and run as a vertical then a horizontal 1D pass, 2 * N multiply-adds per pixel instead of
+// N * N. The output of a band is computed by column tiles of CONVOLUTION_TILE pixels, so that
+// the input rows read by a tile stay in cache while the rows of the band go through it, and
+// each tap is a batch multiply-add over the tile, vectorized for float and double.
+
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "threading.hpp"
+#include "benchmarks.hpp"
+#include "batch.hpp"
+#include "planarimage.hpp"
+#include "sobel.hpp"
+
+// pixels of the column tiles and rows of the bands that the threads take in turn
+#ifndef CONVOLUTION_TILE
+#define CONVOLUTION_TILE 256
+#endif
+
+#ifndef CONVOLUTION_BAND_ROWS
+#define CONVOLUTION_BAND_ROWS 16
+#endif
+
+// square kernel of odd size with double weights, row by row
+struct KernelDescription
+{
+    std::string name;
+    int size;
+    std::vector<double> weights;
+};
+
+// mean of the size x size neighbourhood, separable
+KernelDescription boxKernel(int size)
+{
+    return {"Box " + std::to_string(size) + "x" + std::to_string(size), size,
+            std::vector<double>(size * size, 1.0 / (size * size))};
+}
+
+// binomial approximation of a Gaussian, separable
+KernelDescription gaussianKernel(int size)
+{
+    std::vector<double> binomial(1, 1.0);
+    for(int i = 1; i < size; ++i)
+    {
+        binomial.push_back(0.0);
+        for(int j = i; j > 0; --j)
+            binomial[j] += binomial[j - 1];
+    }
+
+    double total = std::ldexp(1.0, 2 * (size - 1));
+    KernelDescription kernel = {"Gaussian " + std::to_string(size) + "x" + std::to_string(size), size, {}};
+    for(int i = 0; i < size; ++i)
+        for(int j = 0; j < size; ++j)
+            kernel.weights.push_back(binomial[i] * binomial[j] / total);
+    return kernel;
+}
+
+// mean of the pixels within size / 2 of the center, not separable
+KernelDescription diskKernel(int size)
+{
+    const int radius = size / 2;
+    const int limit = radius * radius;
+    KernelDescription kernel = {"Disk " + std::to_string(size) + "x" + std::to_string(size), size, {}};
+    int count = 0;
+    for(int i = -radius; i <= radius; ++i)
+        for(int j = -radius; j <= radius; ++j)
+        {
+            bool inside = i * i + j * j <= limit;
+            kernel.weights.push_back(inside ? 1.0 : 0.0);
+            count += inside;
+        }
+
+    for(double& weight : kernel.weights)
+        weight /= count;
+    return kernel;
+}
+
+// finds column and row such that weights[i][j] = column[i] * row[j] up to rounding, returns
+// false when the kernel is not separable
+bool separateKernel(const KernelDescription& kernel, std::vector<double>* column, std::vector<double>* row)
+{
+    const int n = kernel.size;
+    const std::vector<double>& w = kernel.weights;
+
+    // the largest weight gives the best conditioned column and row
+    int pivot = 0;
+    for(int k = 1; k < n * n; ++k)
+        if(std::fabs(w[k]) > std::fabs(w[pivot]))
+            pivot = k;
+    if(w[pivot] == 0.0)
+        return false;
+
+    column->resize(n);
+    row->resize(n);
+    for(int k = 0; k < n; ++k)
+    {
+        (*column)[k] = w[k * n + pivot % n];
+        (*row)[k] = w[pivot / n * n + k] / w[pivot];
+    }
+
+    for(int i = 0; i < n; ++i)
+        for(int j = 0; j < n; ++j)
+            if(std::fabs(w[i * n + j] - (*column)[i] * (*row)[j]) > 1e-12 * std::fabs(w[pivot]))
+                return false;
+    return true;
+}
+
+// non-zero weight of a kernel and its offset from the center
+template<typename T>
+struct ConvolutionTap
+{
+    int dy;
+    int dx;
+    T weight;
+};
+
+// kernel converted to T, as two 1D passes when it is separable, as its non-zero taps otherwise
+template<typename T>
+struct Convolution
+{
+    int radius;
+    bool separable;
+    std::vector<T> column;
+    std::vector<T> row;
+    std::vector<ConvolutionTap<T> > taps;
+
+    explicit Convolution(const KernelDescription& kernel) : radius(kernel.size / 2)
+    {
+        std::vector<double> columnWeights, rowWeights;
+        separable = separateKernel(kernel, &columnWeights, &rowWeights);
+        if(separable)
+        {
+            column.assign(columnWeights.begin(), columnWeights.end());
+            row.assign(rowWeights.begin(), rowWeights.end());
+            return;
+        }
+
+        for(int i = 0; i < kernel.size; ++i)
+            for(int j = 0; j < kernel.size; ++j)
+                if(kernel.weights[i * kernel.size + j] != 0.0)
+                    taps.push_back({i - radius, j - radius, T(kernel.weights[i * kernel.size + j])});
+    }
+
+    int multiplications() const
+    {
+        return separable ? (int)(column.size() + row.size()) : (int)taps.size();
+    }
+};
+
+// output pixels [x0, x0 + n) of row y of a padded plane with a border of at least the radius,
+// written to out; vertical is a scratch row of CONVOLUTION_TILE + 2 * radius values
+template<typename T>
+void convolveTile(const Convolution<T>& convolution, const PaddedPlane<T>& plane, int y, int x0, int n, T* out, T* vertical)
+{
+    const int r = convolution.radius;
+    auto pixel = [&plane](int y, int x) { return plane.row(y) + plane.border + x; };
+
+    if(convolution.separable)
+    {
+        // vertical pass over the n + 2 * r columns that the horizontal pass reads
+        const int columns = n + 2 * r;
+        batchMul(pixel(y - r, x0 - r), convolution.column[0], vertical, columns);
+        for(int i = 1; i < (int)convolution.column.size(); ++i)
+            batchMulAdd(pixel(y - r + i, x0 - r), convolution.column[i], vertical, vertical, columns);
+
+        batchMul(vertical, convolution.row[0], out, n);
+        for(int j = 1; j < (int)convolution.row.size(); ++j)
+            batchMulAdd(vertical + j, convolution.row[j], out, out, n);
+        return;
+    }
+
+    const ConvolutionTap<T>& first = convolution.taps[0];
+    batchMul(pixel(y + first.dy, x0 + first.dx), first.weight, out, n);
+    for(size_t k = 1; k < convolution.taps.size(); ++k)
+    {
+        const ConvolutionTap<T>& tap = convolution.taps[k];
+        batchMulAdd(pixel(y + tap.dy, x0 + tap.dx), tap.weight, out, out, n);
+    }
+}
+
+// convolves the 3 channels of an image with a kernel, and reports the throughput of the
+// padding and convolution
+template<typename T>
+std::vector<int> convolutionImage(const std::string& inputFileName, const KernelDescription& kernel)
+{
+    PlanarImage<T> srcImage;
+    PlanarImage<T> dstImage;
+    PaddedPlane<T> planes[3];
+
+    loadSobelImage( inputFileName, &srcImage );
+    dstImage.allocate( srcImage.width, srcImage.height );
+    dstImage.meta = srcImage.meta;
+
+    const Convolution<T> convolution( kernel );
+    const int radius = convolution.radius;
+    const int width = srcImage.width;
+    int nThreads = getThreadCount();
+    auto startTime = std::chrono::steady_clock::now();
+
+    for(int c = 0 ; c < 3 ; c++)
+    {
+        allocatePadded( srcImage, &planes[c], radius );
+        for(int y = 0 ; y < srcImage.height ; y++)
+            std::copy(srcImage.row(c, y), srcImage.row(c, y) + width, planes[c].row(y) + radius);
+    }
+
+    runBands(srcImage.height, CONVOLUTION_BAND_ROWS, nThreads, [radius]() { return std::vector<T>(CONVOLUTION_TILE + 2 * radius); },
+             [&convolution, &planes, &dstImage, width](std::vector<T>& vertical, int begin, int end) {
+        for(int x0 = 0 ; x0 < width ; x0 += CONVOLUTION_TILE)
+        {
+            int n = std::min(CONVOLUTION_TILE, width - x0);
+            for(int c = 0 ; c < 3 ; c++)
+                for(int y = begin ; y < end ; y++)
+                    convolveTile(convolution, planes[c], y, x0, n, dstImage.row(c, y) + x0, vertical.data());
+        }
+    });
+
+    auto endTime = std::chrono::steady_clock::now();
+    printThroughput(kernel.name + (convolution.separable ? " (separable, " : " (") + std::to_string(convolution.multiplications())
+                    + " multiply-adds per pixel) on " + std::to_string(nThreads) + " thread(s)",
+                    (double)width * srcImage.height / 1e6, "megapixels",
+                    std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
+
+    return exportPlanarImage(dstImage, T(1));
+}
+
+#endif
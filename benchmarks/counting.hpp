@@ -0,0 +1,294 @@
+#ifndef COUNTING_HPP
+#define COUNTING_HPP
+
+// counting_t<T> behaves like T and counts the operations performed on it, by category.
+// Each thread increments its own counters, which are registered globally so that the totals
+// of a benchmark include its worker threads, and folded into a retired total when it exits.
+// Combined with the cost of each operation for a given type, the counts predict the
+// performance of a benchmark on that type.
+// Sign operations (negation, absolute value) and copies are not counted.
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "utilities.hpp"
+
+enum CountedOperation
+{
+    COUNTED_ADD,            // additions and subtractions
+    COUNTED_MUL,            // multiplications and squares
+    COUNTED_DIV,            // divisions
+    COUNTED_SQRT,
+    COUNTED_EXP_LOG,
+    COUNTED_TRIG,
+    COUNTED_CONVERSION,     // conversions from and to built-in types
+    COUNTED_COMPARISON,
+    COUNTED_OPERATIONS
+};
+
+const char* countedOperationName(int operation)
+{
+    static const char* names[COUNTED_OPERATIONS] = {
+        "add/sub", "mul", "div", "sqrt", "exp/log", "trig", "conversion", "comparison"
+    };
+    return names[operation];
+}
+
+struct OperationCounts
+{
+    uint64_t counts[COUNTED_OPERATIONS] = {};
+};
+
+// counters of the threads that are counting operations, and the sum of the counters of the
+// threads that have exited, so that short-lived worker threads do not accumulate
+struct OperationCountRegistry
+{
+    std::mutex mutex;
+    std::vector<OperationCounts*> threads;
+    OperationCounts retired;
+
+    static OperationCountRegistry& get()
+    {
+        static OperationCountRegistry registry;
+        return registry;
+    }
+
+    void add(OperationCounts* counts)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(counts);
+    }
+
+    // folds the counters of an exiting thread into the retired counts
+    void remove(OperationCounts* counts)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(int i = 0; i < COUNTED_OPERATIONS; ++i)
+            retired.counts[i] += counts->counts[i];
+        threads.erase(std::find(threads.begin(), threads.end(), counts));
+    }
+
+    // totals over all threads, to call while no thread is counting
+    OperationCounts total()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        OperationCounts result = retired;
+        for(const OperationCounts* counts : threads)
+            for(int i = 0; i < COUNTED_OPERATIONS; ++i)
+                result.counts[i] += counts->counts[i];
+        return result;
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired = OperationCounts();
+        for(OperationCounts* counts : threads)
+            *counts = OperationCounts();
+    }
+};
+
+// counters of a thread, registered from its first counted operation until it exits
+struct ThreadOperationCounts
+{
+    OperationCounts counts;
+
+    ThreadOperationCounts()
+    {
+        OperationCountRegistry::get().add(&counts);
+    }
+
+    ~ThreadOperationCounts()
+    {
+        OperationCountRegistry::get().remove(&counts);
+    }
+};
+
+void countOperation(CountedOperation operation)
+{
+    thread_local ThreadOperationCounts thread;
+    ++thread.counts.counts[operation];
+}
+
+template<typename T>
+struct counting_t
+{
+    T value;
+
+    counting_t() = default;
+
+    template<typename N, typename = typename std::enable_if<std::is_arithmetic<N>::value>::type>
+    counting_t(N n) : value(n)
+    {
+        countOperation(COUNTED_CONVERSION);
+    }
+
+    static counting_t wrap(T value)
+    {
+        counting_t result;
+        result.value = value;
+        return result;
+    }
+
+    explicit operator float() const { countOperation(COUNTED_CONVERSION); return (float)value; }
+    explicit operator double() const { countOperation(COUNTED_CONVERSION); return (double)value; }
+    explicit operator long double() const { countOperation(COUNTED_CONVERSION); return (long double)value; }
+    explicit operator int() const { countOperation(COUNTED_CONVERSION); return (int)value; }
+
+    counting_t operator-() const { return wrap(-value); }
+
+    counting_t operator+(const counting_t& o) const { countOperation(COUNTED_ADD); return wrap(value + o.value); }
+    counting_t operator-(const counting_t& o) const { countOperation(COUNTED_ADD); return wrap(value - o.value); }
+    counting_t operator*(const counting_t& o) const { countOperation(COUNTED_MUL); return wrap(value * o.value); }
+    counting_t operator/(const counting_t& o) const { countOperation(COUNTED_DIV); return wrap(value / o.value); }
+
+    counting_t& operator+=(const counting_t& o) { return *this = *this + o; }
+    counting_t& operator-=(const counting_t& o) { return *this = *this - o; }
+    counting_t& operator*=(const counting_t& o) { return *this = *this * o; }
+    counting_t& operator/=(const counting_t& o) { return *this = *this / o; }
+
+    bool operator==(const counting_t& o) const { countOperation(COUNTED_COMPARISON); return value == o.value; }
+    bool operator!=(const counting_t& o) const { countOperation(COUNTED_COMPARISON); return value != o.value; }
+    bool operator<(const counting_t& o) const { countOperation(COUNTED_COMPARISON); return value < o.value; }
+    bool operator>(const counting_t& o) const { countOperation(COUNTED_COMPARISON); return value > o.value; }
+    bool operator<=(const counting_t& o) const { countOperation(COUNTED_COMPARISON); return value <= o.value; }
+    bool operator>=(const counting_t& o) const { countOperation(COUNTED_COMPARISON); return value >= o.value; }
+};
+
+// utilities of counting_t, forwarding to the utilities of T
+
+template<typename T>
+counting_t<T> squareRoot(counting_t<T> value)
+{
+    countOperation(COUNTED_SQRT);
+    return counting_t<T>::wrap(squareRoot(value.value));
+}
+
+template<typename T>
+counting_t<T> naturalLog(counting_t<T> value)
+{
+    countOperation(COUNTED_EXP_LOG);
+    return counting_t<T>::wrap(naturalLog(value.value));
+}
+
+template<typename T>
+counting_t<T> expValue(counting_t<T> value)
+{
+    countOperation(COUNTED_EXP_LOG);
+    return counting_t<T>::wrap(expValue(value.value));
+}
+
+template<typename T>
+counting_t<T> fmaValue(counting_t<T> a, counting_t<T> b, counting_t<T> c)
+{
+    countOperation(COUNTED_MUL);
+    countOperation(COUNTED_ADD);
+    return counting_t<T>::wrap(fmaValue(a.value, b.value, c.value));
+}
+
+template<typename T>
+counting_t<T> square(counting_t<T> value)
+{
+    countOperation(COUNTED_MUL);
+    return counting_t<T>::wrap(square(value.value));
+}
+
+template<typename T>
+bool isZero(counting_t<T> value)
+{
+    countOperation(COUNTED_COMPARISON);
+    return isZero(value.value);
+}
+
+template<typename T>
+bool isPositive(counting_t<T> value)
+{
+    countOperation(COUNTED_COMPARISON);
+    return isPositive(value.value);
+}
+
+template<typename T>
+bool isNegative(counting_t<T> value)
+{
+    countOperation(COUNTED_COMPARISON);
+    return isNegative(value.value);
+}
+
+template<typename T>
+counting_t<T> cosValue(counting_t<T> value)
+{
+    countOperation(COUNTED_TRIG);
+    return counting_t<T>::wrap(cosValue(value.value));
+}
+
+template<typename T>
+counting_t<T> sinValue(counting_t<T> value)
+{
+    countOperation(COUNTED_TRIG);
+    return counting_t<T>::wrap(sinValue(value.value));
+}
+
+template<typename T>
+void sinCosValue(counting_t<T> value, counting_t<T>* s, counting_t<T>* c)
+{
+    countOperation(COUNTED_TRIG);
+    sinCosValue(value.value, &s->value, &c->value);
+}
+
+template<typename T>
+counting_t<T> absValue(counting_t<T> value)
+{
+    return counting_t<T>::wrap(absValue(value.value));
+}
+
+template<typename T>
+counting_t<T> acosValue(counting_t<T> value)
+{
+    countOperation(COUNTED_TRIG);
+    return counting_t<T>::wrap(acosValue(value.value));
+}
+
+template<typename T>
+counting_t<T> asinValue(counting_t<T> value)
+{
+    countOperation(COUNTED_TRIG);
+    return counting_t<T>::wrap(asinValue(value.value));
+}
+
+template<typename T>
+void readFromStream(std::istream& stream, counting_t<T>& value)
+{
+    countOperation(COUNTED_CONVERSION);
+    readFromStream(stream, value.value);
+}
+
+// prints the counts of a benchmark as a histogram
+void printOperationCounts(const std::string& name, const OperationCounts& counts)
+{
+    uint64_t total = 0, largest = 0;
+    for(int i = 0; i < COUNTED_OPERATIONS; ++i)
+    {
+        total += counts.counts[i];
+        largest = std::max(largest, counts.counts[i]);
+    }
+    if(total == 0)
+        return;
+
+    std::cout << "Operation counts of " << name << ":" << std::endl;
+    for(int i = 0; i < COUNTED_OPERATIONS; ++i)
+    {
+        std::string label = countedOperationName(i);
+        std::cout << "  " << label << std::string(12 - label.size(), ' ') << counts.counts[i]
+                  << " (" << std::setprecision(3) << (100.0 * counts.counts[i] / total) << "%) "
+                  << std::string((size_t)(40.0 * counts.counts[i] / largest + 0.5), '#') << std::endl;
+    }
+}
+
+#endif
@@ -12,7 +12,6 @@
 template<typename T>
 std::vector<float> fft(int n)
 {
-    std::vector<float> output;
     static int* indices;
     static Complex<T>* x;
     static Complex<T>* f;
@@ -36,17 +35,50 @@ std::vector<float> fft(int n)
         x[i].real = T(i);
         x[i].imag = T(0) ;
     }
-    radix2DitCooleyTykeyFft<T>(K, indices, x, f) ;
+    arbitraryLengthFft<T>(K, indices, x, f) ;
 
+    std::vector<float> output;
     for(i = 0;i < K ; i++)
     {
         output.push_back((float) f[i].real);
         output.push_back((float) f[i].imag);
     }
+
     free(indices);
     free(x);
     free(f);
     return output;
 }
 
+// FFT on PolarComplex values, the result is converted back to Cartesian form for comparison
+template<typename T, typename Addition>
+std::vector<float> fftPolar(int n)
+{
+    std::vector<float> output;
+
+    if(!isPowerOfTwo(n))
+    {
+        std::cout << "polar FFT requires a power of two size" << std::endl;
+        exit(1);
+    }
+
+    std::vector<PolarComplex<T>> x(n), f(n);
+    std::vector<int> indices(n);
+
+    for(int i = 0; i < n; i++)
+    {
+        x[i].magnitude = T(i);
+        x[i].phase = 0;
+    }
+    radix2PolarFft<T, Addition>(n, indices.data(), x.data(), f.data());
+
+    for(int i = 0; i < n; i++)
+    {
+        Complex<T> c = toCartesian(f[i]);
+        output.push_back((float) c.real);
+        output.push_back((float) c.imag);
+    }
+    return output;
+}
+
 #endif
\ No newline at end of file
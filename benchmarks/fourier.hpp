@@ -4,7 +4,16 @@
 #include "complex.hpp"
 #include <iostream>
 #include <cmath>
+#include <vector>
 
+#define MAX_FFT_RADIX 5
+
+bool isPowerOfTwo(int K)
+{
+    return K > 0 && (K & (K - 1)) == 0;
+}
+
+// bit-reversal permutation, K must be a power of two
 void calcFftIndices(int K, int* indices)
 {
     int i, j ;
@@ -38,6 +47,7 @@ void radix2DitCooleyTykeyFft(int K, int* indices, Complex<T>* x, Complex<T>* f)
     T fftCos;
 
     Complex<T> t;
+    Complex<T> u;
     int i ;
     int N ;
     int j ;
@@ -57,12 +67,55 @@ void radix2DitCooleyTykeyFft(int K, int* indices, Complex<T>* x, Complex<T>* f)
                 fftSinCos(arg, &fftSin, &fftCos);
 
                 // Non-approximate
+                // the odd term is twiddled once, before either output overwrites it
                 t =  x[indices[eI]] ;
-                x[indices[eI]].real = t.real + (x[indices[oI]].real * fftCos - x[indices[oI]].imag * fftSin);
-                x[indices[eI]].imag = t.imag + (x[indices[oI]].imag * fftCos + x[indices[oI]].real * fftSin);
+                u.real = x[indices[oI]].real * fftCos - x[indices[oI]].imag * fftSin;
+                u.imag = x[indices[oI]].imag * fftCos + x[indices[oI]].real * fftSin;
+
+                x[indices[eI]].real = t.real + u.real;
+                x[indices[eI]].imag = t.imag + u.imag;
+
+                x[indices[oI]].real = t.real - u.real;
+                x[indices[oI]].imag = t.imag - u.imag;
+            }
+        }
+    }
+
+    for (int i = 0 ; i < K ; i++)
+    {
+        f[i] = x[indices[i]] ;
+    }
+}
+
+// same radix-2 decimation in time on PolarComplex values: twiddle factors are exact phase
+// rotations and each butterfly is one call to the Addition strategy
+template<typename T, typename Addition>
+void radix2PolarFft(int K, int* indices, PolarComplex<T>* x, PolarComplex<T>* f)
+{
+    calcFftIndices(K, indices) ;
+
+    int step ;
+    int eI ;
+    int oI ;
+
+    PolarComplex<T> t;
+    int i ;
+    int N ;
+    int j ;
+    int k ;
 
-                x[indices[oI]].real = t.real - (x[indices[oI]].real * fftCos - x[indices[oI]].imag * fftSin);
-                x[indices[oI]].imag = t.imag - (x[indices[oI]].imag * fftCos + x[indices[oI]].real * fftSin);
+    for(i = 0, N = 1 << (i + 1); N <= K ; i++, N = 1 << (i + 1))
+    {
+        for(j = 0 ; j < K ; j += N)
+        {
+            step = N >> 1 ;
+            for(k = 0; k < step ; k++)
+            {
+                eI = j + k ;
+                oI = j + step + k ;
+
+                t = rotate(x[indices[oI]], fftTwiddlePhase(k, N));
+                Addition::addSub(x[indices[eI]], t, &x[indices[eI]], &x[indices[oI]]);
             }
         }
     }
@@ -73,4 +126,172 @@ void radix2DitCooleyTykeyFft(int K, int* indices, Complex<T>* x, Complex<T>* f)
     }
 }
 
+// recursive decimation in time for sizes made only of the radices 2, 3 and 5
+// x is read with the given stride, f receives the n output values
+template<typename T>
+void mixedRadixFft(int n, int stride, const int* radices, const Complex<T>* x, Complex<T>* f,
+                   const std::vector<Complex<T>>* roots)
+{
+    if(n == 1)
+    {
+        f[0] = x[0];
+        return;
+    }
+
+    int r = radices[0];
+    int m = n / r;
+    int q, u, k;
+
+    for(q = 0; q < r; q++)
+    {
+        mixedRadixFft(m, stride * r, radices + 1, x + q * stride, f + q * m, roots);
+    }
+
+    T fftSin;
+    T fftCos;
+    Complex<T> t[MAX_FFT_RADIX];
+    Complex<T> y;
+
+    for(k = 0; k < m; k++)
+    {
+        // twiddle the outputs of the sub-transforms
+        t[0] = f[k];
+        for(q = 1; q < r; q++)
+        {
+            const Complex<T>& v = f[q * m + k];
+            fftSinCos(T(q * k) / T(n), &fftSin, &fftCos);
+            t[q].real = v.real * fftCos - v.imag * fftSin;
+            t[q].imag = v.imag * fftCos + v.real * fftSin;
+        }
+
+        if(r == 2)
+        {
+            f[k].real = t[0].real + t[1].real;
+            f[k].imag = t[0].imag + t[1].imag;
+            f[m + k].real = t[0].real - t[1].real;
+            f[m + k].imag = t[0].imag - t[1].imag;
+            continue;
+        }
+
+        // radix-r DFT of the twiddled values
+        for(u = 0; u < r; u++)
+        {
+            y = t[0];
+            for(q = 1; q < r; q++)
+            {
+                const Complex<T>& w = roots[r][(q * u) % r];
+                y.real += t[q].real * w.real - t[q].imag * w.imag;
+                y.imag += t[q].imag * w.real + t[q].real * w.imag;
+            }
+            f[u * m + k] = y;
+        }
+    }
+}
+
+// Bluestein chirp-z transform: a size K DFT expressed as a circular convolution
+// computed with power of two FFTs of size M >= 2K - 1
+template<typename T>
+void bluesteinFft(int K, Complex<T>* x, Complex<T>* f)
+{
+    int M = 1;
+    while(M < 2 * K - 1)
+        M <<= 1;
+
+    const Complex<T> zero = {T(0), T(0)};
+    std::vector<Complex<T>> chirp(K), a(M, zero), b(M, zero), fa(M), fb(M);
+    std::vector<int> indices(M);
+    T fftSin;
+    T fftCos;
+    int k;
+
+    // chirp[k] = exp(-i * PI * k^2 / K), k^2 is reduced modulo 2K to keep the argument small
+    for(k = 0; k < K; k++)
+    {
+        long long e = ((long long)k * k) % (2 * K);
+        fftSinCos(T((int)e) / T(2 * K), &fftSin, &fftCos);
+        chirp[k].real = fftCos;
+        chirp[k].imag = fftSin;
+    }
+
+    for(k = 0; k < K; k++)
+    {
+        a[k].real = x[k].real * chirp[k].real - x[k].imag * chirp[k].imag;
+        a[k].imag = x[k].imag * chirp[k].real + x[k].real * chirp[k].imag;
+    }
+
+    b[0].real = chirp[0].real;
+    b[0].imag = -chirp[0].imag;
+    for(k = 1; k < K; k++)
+    {
+        b[k].real = b[M - k].real = chirp[k].real;
+        b[k].imag = b[M - k].imag = -chirp[k].imag;
+    }
+
+    radix2DitCooleyTykeyFft<T>(M, indices.data(), a.data(), fa.data());
+    radix2DitCooleyTykeyFft<T>(M, indices.data(), b.data(), fb.data());
+
+    // the inverse transform of the product is computed as conj(FFT(conj(product))) / M
+    for(k = 0; k < M; k++)
+    {
+        a[k].real = fa[k].real * fb[k].real - fa[k].imag * fb[k].imag;
+        a[k].imag = -(fa[k].imag * fb[k].real + fa[k].real * fb[k].imag);
+    }
+    radix2DitCooleyTykeyFft<T>(M, indices.data(), a.data(), fa.data());
+
+    T invM = T(1) / T(M);
+    for(k = 0; k < K; k++)
+    {
+        T real = fa[k].real * invM;
+        T imag = -fa[k].imag * invM;
+        f[k].real = real * chirp[k].real - imag * chirp[k].imag;
+        f[k].imag = imag * chirp[k].real + real * chirp[k].imag;
+    }
+}
+
+// FFT of any size K: radix 2 for powers of two, mixed radix 2/3/5 when K has no other
+// prime factor, Bluestein otherwise
+template<typename T>
+void arbitraryLengthFft(int K, int* indices, Complex<T>* x, Complex<T>* f)
+{
+    if(isPowerOfTwo(K))
+    {
+        radix2DitCooleyTykeyFft<T>(K, indices, x, f);
+        return;
+    }
+
+    std::vector<int> radices;
+    int remainder = K;
+    for(int radix : {2, 3, 5})
+    {
+        while(remainder % radix == 0)
+        {
+            radices.push_back(radix);
+            remainder /= radix;
+        }
+    }
+
+    if(remainder != 1)
+    {
+        bluesteinFft<T>(K, x, f);
+        return;
+    }
+
+    // roots[r][j] = exp(-2 * i * PI * j / r) for the radices in use
+    std::vector<Complex<T>> roots[MAX_FFT_RADIX + 1];
+    T fftSin;
+    T fftCos;
+    for(int radix : radices)
+    {
+        if(!roots[radix].empty())
+            continue;
+        for(int j = 0; j < radix; j++)
+        {
+            fftSinCos(T(j) / T(radix), &fftSin, &fftCos);
+            roots[radix].push_back({fftCos, fftSin});
+        }
+    }
+
+    mixedRadixFft<T>(K, 1, radices.data(), x, f, roots);
+}
+
 #endif
\ No newline at end of file
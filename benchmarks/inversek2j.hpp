@@ -15,34 +15,73 @@
 #include <string>
 #include <vector>
 #include "utilities.hpp"
+#include "batch.hpp"
+
+// lengths of the two links of the arm, and the constants of the inverse kinematics derived
+// from them (a = 2 * l1 * l2, b = l1^2 + l2^2), converted once per type before main
+template<typename T> const T armLength1 = T(0.5);
+template<typename T> const T armLength2 = T(0.5);
+template<typename T> const T armA = T(2 * 0.5 * 0.5);
+template<typename T> const T armB = T(0.5 * 0.5 + 0.5 * 0.5);
 
 template<typename T>
 void forward(T theta1, T theta2, T* x, T* y) {
 
-    static const T l1(0.5);
-    static const T l2(0.5);
+    const T& l1 = armLength1<T>;
+    const T& l2 = armLength2<T>;
+
+    T sin1, cos1, sin2, cos2;
+    sinCosValue(theta1, &sin1, &cos1);
+    sinCosValue(theta2, &sin2, &cos2);
+
+    // angle-sum identities for theta1 + theta2
+    T cos12 = cos1 * cos2 - sin1 * sin2;
+    T sin12 = sin1 * cos2 + cos1 * sin2;
 
-    *x = l1 * cosValue(theta1) + l2 * cosValue(theta1 + theta2) ;
-    *y = l1 * sinValue(theta1) + l2 * sinValue(theta1 + theta2) ;
+    *x = l1 * cos1 + l2 * cos12 ;
+    *y = l1 * sin1 + l2 * sin12 ;
 }
 
+// inverse kinematics of n points, the arithmetic runs on whole arrays with the batch kernels
 template<typename T>
-void inverse(T x, T y, T* theta1, T* theta2) {
+void inverse(const T* x, const T* y, T* theta1, T* theta2, size_t n) {
 
-    static const T l1(0.5);
-    static const T l2(0.5);
-    static const T a(T(2) * l1 * l2);
-    static const T b((l1 * l1) + (l2 * l2));
+    const T& l1 = armLength1<T>;
+    const T& l2 = armLength2<T>;
+    const T& a = armA<T>;
+    const T& b = armB<T>;
 
-    *theta2 = acosValue(((x * x) + (y * y) - b) / a);
-    *theta1 = asinValue((y * (l1 + l2 * cosValue(*theta2)) - x * l2 * sinValue(*theta2))/(x * x + y * y));
+    std::vector<T> r2(n), sin2(n), cos2(n), t(n), u(n);
+
+    batchSquare(x, t.data(), n);
+    batchSquare(y, u.data(), n);
+    batchAdd(t.data(), u.data(), r2.data(), n);
+
+    batchSub(r2.data(), b, t.data(), n);
+    batchDiv(t.data(), a, t.data(), n);
+    for(size_t i = 0 ; i < n ; i++)
+    {
+        theta2[i] = acosValue(t[i]);
+        sinCosValue(theta2[i], &sin2[i], &cos2[i]);
+    }
+
+    // (y * (l1 + l2 * cos2) - x * l2 * sin2) / (x * x + y * y)
+    batchMul(cos2.data(), l2, t.data(), n);
+    batchAdd(t.data(), l1, t.data(), n);
+    batchMul(y, t.data(), t.data(), n);
+    batchMul(x, l2, u.data(), n);
+    batchMul(u.data(), sin2.data(), u.data(), n);
+    batchSub(t.data(), u.data(), t.data(), n);
+    batchDiv(t.data(), r2.data(), t.data(), n);
+    for(size_t i = 0 ; i < n ; i++)
+    {
+        theta1[i] = asinValue(t[i]);
+    }
 }
 
 template<typename T>
 std::vector<float> inversek2j(const std::string& inputFileName)
 {
-    std::vector<float> output;
-
     std::ifstream file(inputFileName);
     if(!file) {
         std::cout << "ERROR: Unable to open file " << inputFileName << std::endl;
@@ -54,40 +93,26 @@ std::vector<float> inversek2j(const std::string& inputFileName)
     // first line defins the number of enteries
     file >> n;
 
-    T* t1t2xy = (T*)malloc(n * 2 * 2 * sizeof(T));
-
-    if(t1t2xy == nullptr)
-    {
-        std::cerr << "# Cannot allocate memory for the coordinates an angles!" << std::endl;
-        exit(1);
-    }
+    // angles and coordinates are stored as separate arrays
+    std::vector<T> theta1(n), theta2(n), x(n), y(n);
 
-    for(int i = 0 ; i < n * 2 * 2 ; i += 2 * 2)
+    for(int i = 0 ; i < n ; i++)
     {
-        T theta1, theta2;
-        readFromStream(file, theta1);
-        readFromStream(file, theta2);
+        readFromStream(file, theta1[i]);
+        readFromStream(file, theta2[i]);
 
-        t1t2xy[i] = theta1;
-        t1t2xy[i + 1] = theta2;
-
-        forward(t1t2xy[i + 0], t1t2xy[i + 1], t1t2xy + (i + 2), t1t2xy + (i + 3));
+        forward(theta1[i], theta2[i], &x[i], &y[i]);
     }
 
-    for(int i = 0 ; i < n * 2 * 2 ; i += 2 * 2)
-    {
-        inverse(t1t2xy[i + 2], t1t2xy[i + 3], t1t2xy + (i + 0), t1t2xy + (i + 1));
-    }
+    inverse(x.data(), y.data(), theta1.data(), theta2.data(), n);
 
-    for(int i = 0 ; i < n * 2 * 2 ; i += 2 * 2)
+    std::vector<float> output;
+    for(int i = 0 ; i < n ; i++)
     {
-        output.push_back((float)t1t2xy[i+0]);
-        output.push_back((float)t1t2xy[i+1]);
+        output.push_back((float)theta1[i]);
+        output.push_back((float)theta2[i]);
     }
 
-    free(t1t2xy);
-    t1t2xy = nullptr;
-
     return output;
 }
 
@@ -36,14 +36,9 @@ std::vector<bool> jmeint(const std::string& inputFileName)
         exit(1);
     }
 
-    i = 0;
-    while (i < n)
+    for(i = 0 ; i < n * 6 * 3 ; i++)
     {
-        for(int j = 0 ; j < 18; j++)
-        {
-            readFromStream(file, xyz[i * 18 + j]);
-        }
-        i++;
+        readFromStream(file, xyz[i]);
     }
 
     for(i = 0 ; i < (n * 6 * 3); i += 6 * 3)
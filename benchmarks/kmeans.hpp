@@ -2,33 +2,156 @@
 #define KMEANS_HPP
 
 #include <cstdio>
+#include <cstdint>
+#include <algorithm>
 #include <string>
 #include <iostream>
-#include <ctime>
+#include <chrono>
+#include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include "segmentation.hpp"
+#include "colorhistogram.hpp"
+#include "threading.hpp"
 
+// iterations, time and number of pixel to centroid distances computed by a k-means run, and
+// whether the centroids converged before the maximum number of iterations
+struct KmeansRun
+{
+    int iterations;
+    long long int microseconds;
+    uint64_t distances;
+    bool converged;
+};
+
+// segments a loaded image into k clusters, with centroids drawn from the current rand() state
+template<typename T>
+KmeansRun runKmeans(PlanarImage<T>* image, int k, KmeansAlgorithm algorithm, int nThreads)
+{
+    Clusters<T> clusters;
+    KmeansRun run = {0, 0, 0, false};
+
+    initClusters(&clusters, k, T(1));
+
+    auto startTime = std::chrono::steady_clock::now();
+    run.iterations = segmentImage(image, &clusters, KMEANS_ITERATIONS, KMEANS_THRESHOLD, nThreads, algorithm, &run.distances, &run.converged);
+    auto endTime = std::chrono::steady_clock::now();
+    run.microseconds = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+
+    freeClusters(&clusters);
+    return run;
+}
+
+void printKmeansRun(const std::string& name, const KmeansRun& run, int k, size_t pixels, int nThreads)
+{
+    double evaluations = (double)run.iterations * pixels * k;
+    std::cout << name << (run.converged ? " converged after " : " stopped after ") << run.iterations
+              << " iteration(s) with " << k << " clusters on " << nThreads << " thread(s), " << std::setprecision(10)
+              << (run.microseconds / 1000.0 / run.iterations) << " ms per iteration, "
+              << (100.0 * (1.0 - run.distances / evaluations)) << "% of the distances skipped" << std::endl;
+}
+
+// the centroids are seeded with the number of clusters, so that both types start from the same
+// centroids
 template<typename T>
 std::vector<int> kmeans(const std::string& inputFileName)
 {
-    srand(time(NULL));
+    srand(KMEANS_CLUSTERS);
+
+    PlanarImage<T> srcImage;
+
+    loadRgbImage(inputFileName.c_str(), &srcImage, T(256));
+
+    int nThreads = getThreadCount();
+    KmeansRun run = runKmeans(&srcImage, KMEANS_CLUSTERS, KMEANS_ALGORITHM, nThreads);
+    printKmeansRun(std::string("Kmeans (") + kmeansAlgorithmName(KMEANS_ALGORITHM) + ")", run, KMEANS_CLUSTERS,
+                   (size_t)srcImage.width * srcImage.height, nThreads);
+
+    auto output = exportRgbImage(srcImage, T(256));
+
+    return output;
+}
+
+// runs Lloyd, Hamerly and Elkan from the same centroids, reports the distances skipped by the
+// bounds, the speedup per iteration and the labels that differ from Lloyd (ties, or rounding
+// of the bounds), and returns the output of Elkan
+template<typename T>
+std::vector<int> kmeansAlgorithms(const std::string& inputFileName, int k)
+{
+    const KmeansAlgorithm algorithms[] = {KMEANS_LLOYD, KMEANS_HAMERLY, KMEANS_ELKAN};
+    int nThreads = getThreadCount();
+    std::vector<int> output, lloydLabels;
+    double lloydIterationTime = 0.0;
+
+    for (KmeansAlgorithm algorithm : algorithms) {
+        PlanarImage<T> image;
+        loadRgbImage(inputFileName.c_str(), &image, T(256));
+        size_t pixels = (size_t)image.width * image.height;
+
+        srand(k);
+        KmeansRun run = runKmeans(&image, k, algorithm, nThreads);
+        printKmeansRun(kmeansAlgorithmName(algorithm), run, k, pixels, nThreads);
+
+        std::vector<int> labels;
+        labels.reserve(pixels);
+        for (int y = 0; y < image.height; y++)
+            labels.insert(labels.end(), image.labelRow(y), image.labelRow(y) + image.width);
+
+        double iterationTime = (double)run.microseconds / run.iterations;
+        if (algorithm == KMEANS_LLOYD) {
+            lloydLabels.swap(labels);
+            lloydIterationTime = iterationTime;
+        }
+        else {
+            size_t differences = 0;
+            for (size_t i = 0; i < pixels; i++)
+                differences += labels[i] != lloydLabels[i];
+            std::cout << "  " << (lloydIterationTime / std::max(iterationTime, 1.0)) << " times the speed of Lloyd per iteration, "
+                      << differences << " label(s) differ from Lloyd" << std::endl;
+        }
 
-    RgbImage<T> srcImage;
+        output = exportRgbImage(image, T(256));
+    }
+
+    return output;
+}
+
+// k-means on the distinct colors of the image weighted by their counts, the labels are mapped
+// back to the pixels when the image is exported; the centroids are seeded like in kmeans
+template<typename T>
+std::vector<int> kmeansColors(const std::string& inputFileName)
+{
+    srand(KMEANS_CLUSTERS);
+
+    ColorHistogram<T> histogram;
     Clusters<T> clusters;
+    KmeansRun run = {0, 0, 0, false};
 
-    initRgbImage(&srcImage);
+    auto loadTime = std::chrono::steady_clock::now();
+    if (!loadColorHistogram(inputFileName.c_str(), &histogram, T(256)))
+        return std::vector<int>();
+    auto startTime = std::chrono::steady_clock::now();
 
-    loadRgbImage(inputFileName.c_str(), &srcImage, T(256));
+    size_t pixels = (size_t)histogram.width * histogram.height;
+    size_t colors = histogram.r.size();
+    std::cout << std::setprecision(10) << colors << " distinct colors for " << pixels << " pixels ("
+              << ((double)pixels / std::max(colors, (size_t)1)) << " pixels per color), histogram built in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(startTime - loadTime).count() / 1000.0 << " ms with parsing" << std::endl;
+
+    initClusters(&clusters, KMEANS_CLUSTERS, T(1));
 
-    initClusters(&clusters, 6, T(1));
-    segmentImage(&srcImage, &clusters, 1);
+    int nThreads = getThreadCount();
+    startTime = std::chrono::steady_clock::now();
+    run.iterations = segmentColors(&histogram, &clusters, KMEANS_ITERATIONS, KMEANS_THRESHOLD, nThreads, &run.distances, &run.converged);
+    auto endTime = std::chrono::steady_clock::now();
+    run.microseconds = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
 
-    auto output = exportRgbImage(&srcImage, T(256));
+    // the skipped distances are those of the pixels that share a color
+    printKmeansRun("Kmeans on colors", run, KMEANS_CLUSTERS, pixels, nThreads);
 
+    auto output = exportColorHistogram(histogram, clusters, T(256));
 
-    freeRgbImage(&srcImage);
     freeClusters(&clusters);
     return output;
 }
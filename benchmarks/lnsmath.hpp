@@ -0,0 +1,236 @@
+#ifndef LNS_MATH_HPP
+#define LNS_MATH_HPP
+
+// Elementary functions evaluated with LNS arithmetic instead of a round trip through double.
+// Multiplications, squares and square roots are exact exponent operations in LNS, so the
+// kernels use polynomials in x^2 (Horner form) and square-root based range reductions.
+// The number of polynomial terms is chosen from the fractional bits of the type so that the
+// truncation error stays below half a unit in the last place of the exponent.
+
+#include <cmath>
+#include <vector>
+#include "../lns.hpp"
+
+// number of terms of the sin and cos Taylor series needed on [-PI/4, PI/4]
+constexpr int lnsSinCosTerms(int F)
+{
+    double bound = 1.0;
+    for(int i = 0; i <= F; ++i)
+        bound /= 2;
+
+    // term = (PI/4)^n / n!, the sin and cos series alternate between odd and even n
+    double term = 1.0;
+    int n = 0;
+    while(term >= bound)
+    {
+        ++n;
+        term *= (M_PI / 4) / n;
+    }
+    return n / 2 + 1;
+}
+
+// number of terms of the asin series needed on [-1/2, 1/2]
+constexpr int lnsAsinTerms(int F)
+{
+    double bound = 1.0;
+    for(int i = 0; i <= F; ++i)
+        bound /= 2;
+
+    // term = a_n * (1/2)^(2n+1) with a_n / a_(n-1) = (2n-1)^2 / (2n(2n+1))
+    double term = 0.5;
+    int n = 0;
+    while(term >= bound)
+    {
+        ++n;
+        term *= 0.25 * (2 * n - 1) * (2 * n - 1) / ((2.0 * n) * (2 * n + 1));
+    }
+    return n + 1;
+}
+
+// constants and Horner coefficients of the trigonometric kernels, built once per type
+template<int I, int F, int A>
+struct LnsTrigTables
+{
+    using L = lns::lns_t<I, F, A>;
+
+    static const int sinCosTerms = lnsSinCosTerms(F);
+    static const int asinTerms = lnsAsinTerms(F);
+
+    L one, two, half, pi, halfPi, quarterPi, twoOverPi;
+    L reductionLimit;             // largest argument reduced in LNS arithmetic
+    std::vector<L> sinCoeffs;     // 1 / ((2n)(2n+1)) at index n - 1, n >= 1
+    std::vector<L> cosCoeffs;     // 1 / ((2n-1)(2n)) at index n - 1, n >= 1
+    std::vector<L> asinCoeffs;    // (2n-1)^2 / ((2n)(2n+1)) at index n - 1, n >= 1
+
+    LnsTrigTables() : one(1), two(2), half(0.5), pi(M_PI), halfPi(M_PI_2), quarterPi(M_PI_4), twoOverPi(M_2_PI),
+                     reductionLimit(2 * M_PI)
+    {
+        for(int n = 1; n < sinCosTerms; ++n)
+        {
+            sinCoeffs.emplace_back(1.0 / ((2.0 * n) * (2 * n + 1)));
+            cosCoeffs.emplace_back(1.0 / ((2.0 * n - 1) * (2 * n)));
+        }
+        for(int n = 1; n < asinTerms; ++n)
+            asinCoeffs.emplace_back((2.0 * n - 1) * (2 * n - 1) / ((2.0 * n) * (2 * n + 1)));
+    }
+
+    static const LnsTrigTables& get()
+    {
+        static const LnsTrigTables tables;
+        return tables;
+    }
+};
+
+// sin(r) / r for |r| <= PI/4 as a function of z = r^2: 1 - z/(2*3) * (1 - z/(4*5) * (1 - ...))
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsSinPolynomial(lns::lns_t<I, F, A> z, const LnsTrigTables<I, F, A>& t)
+{
+    lns::lns_t<I, F, A> p = t.one;
+    for(int n = LnsTrigTables<I, F, A>::sinCosTerms - 1; n > 0; --n)
+        p = t.one - z * p * t.sinCoeffs[n - 1];
+    return p;
+}
+
+// cos(r) for |r| <= PI/4 as a function of z = r^2: 1 - z/(1*2) * (1 - z/(3*4) * (1 - ...))
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsCosPolynomial(lns::lns_t<I, F, A> z, const LnsTrigTables<I, F, A>& t)
+{
+    lns::lns_t<I, F, A> p = t.one;
+    for(int n = LnsTrigTables<I, F, A>::sinCosTerms - 1; n > 0; --n)
+        p = t.one - z * p * t.cosCoeffs[n - 1];
+    return p;
+}
+
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsSinKernel(lns::lns_t<I, F, A> r, const LnsTrigTables<I, F, A>& t)
+{
+    return r * lnsSinPolynomial(r.square(), t);
+}
+
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsCosKernel(lns::lns_t<I, F, A> r, const LnsTrigTables<I, F, A>& t)
+{
+    return lnsCosPolynomial(r.square(), t);
+}
+
+// reduces x to r = x - k * PI/2 with |r| <= PI/4 and returns k modulo 4, for |x| up to the
+// reduction limit of 2*PI: the rounding of k * PI/2 grows with x and costs about one bit of r
+// at the limit, larger arguments go through double like NaN and infinities
+template<int I, int F, int A>
+int lnsReduceHalfPi(lns::lns_t<I, F, A> x, lns::lns_t<I, F, A>* r, const LnsTrigTables<I, F, A>& t)
+{
+    if(x.abs() <= t.quarterPi)
+    {
+        *r = x;
+        return 0;
+    }
+
+    lns::lns_t<I, F, A> q = x * t.twoOverPi;
+    int k = (int)(q.isNegative() ? q - t.half : q + t.half);
+    *r = x - lns::lns_t<I, F, A>(k) * t.halfPi;
+    return k & 3;
+}
+
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsSin(lns::lns_t<I, F, A> x)
+{
+    const LnsTrigTables<I, F, A>& t = LnsTrigTables<I, F, A>::get();
+    if(x.isNan() || x.isInf() || x.abs() > t.reductionLimit)
+        return lns::lns_t<I, F, A>(std::sin((double)x));
+
+    lns::lns_t<I, F, A> r;
+    switch(lnsReduceHalfPi(x, &r, t))
+    {
+        case 0: return lnsSinKernel(r, t);
+        case 1: return lnsCosKernel(r, t);
+        case 2: return -lnsSinKernel(r, t);
+        default: return -lnsCosKernel(r, t);
+    }
+}
+
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsCos(lns::lns_t<I, F, A> x)
+{
+    const LnsTrigTables<I, F, A>& t = LnsTrigTables<I, F, A>::get();
+    if(x.isNan() || x.isInf() || x.abs() > t.reductionLimit)
+        return lns::lns_t<I, F, A>(std::cos((double)x));
+
+    lns::lns_t<I, F, A> r;
+    switch(lnsReduceHalfPi(x, &r, t))
+    {
+        case 0: return lnsCosKernel(r, t);
+        case 1: return -lnsSinKernel(r, t);
+        case 2: return -lnsCosKernel(r, t);
+        default: return lnsSinKernel(r, t);
+    }
+}
+
+// sin and cos sharing the range reduction and the square of the reduced argument
+template<int I, int F, int A>
+void lnsSinCos(lns::lns_t<I, F, A> x, lns::lns_t<I, F, A>* s, lns::lns_t<I, F, A>* c)
+{
+    const LnsTrigTables<I, F, A>& t = LnsTrigTables<I, F, A>::get();
+    if(x.isNan() || x.isInf() || x.abs() > t.reductionLimit)
+    {
+        *s = lns::lns_t<I, F, A>(std::sin((double)x));
+        *c = lns::lns_t<I, F, A>(std::cos((double)x));
+        return;
+    }
+
+    lns::lns_t<I, F, A> r;
+    int quadrant = lnsReduceHalfPi(x, &r, t);
+    lns::lns_t<I, F, A> z = r.square();
+    lns::lns_t<I, F, A> sr = r * lnsSinPolynomial(z, t);
+    lns::lns_t<I, F, A> cr = lnsCosPolynomial(z, t);
+    switch(quadrant)
+    {
+        case 0: *s = sr; *c = cr; break;
+        case 1: *s = cr; *c = -sr; break;
+        case 2: *s = -sr; *c = -cr; break;
+        default: *s = -cr; *c = sr; break;
+    }
+}
+
+// asin(x) for |x| <= 1/2: x * (1 + x^2 * c1 * (1 + x^2 * c2 * (1 + ...)))
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsAsinKernel(lns::lns_t<I, F, A> x, const LnsTrigTables<I, F, A>& t)
+{
+    lns::lns_t<I, F, A> z = x.square();
+    lns::lns_t<I, F, A> p = t.one;
+    for(int n = LnsTrigTables<I, F, A>::asinTerms - 1; n > 0; --n)
+        p = t.one + z * p * t.asinCoeffs[n - 1];
+    return x * p;
+}
+
+// inputs outside of [-1, 1] are clamped, like the other acos/asin utilities
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsAsin(lns::lns_t<I, F, A> x)
+{
+    const LnsTrigTables<I, F, A>& t = LnsTrigTables<I, F, A>::get();
+    lns::lns_t<I, F, A> a = x.abs();
+    if(a <= t.half)
+        return lnsAsinKernel(x, t);
+    if(a > t.one)
+        a = t.one;
+
+    // asin(a) = PI/2 - 2 * asin(sqrt((1 - a) / 2))
+    lns::lns_t<I, F, A> r = t.halfPi - t.two * lnsAsinKernel(((t.one - a) * t.half).sqrt(), t);
+    return x.isNegative() ? -r : r;
+}
+
+template<int I, int F, int A>
+lns::lns_t<I, F, A> lnsAcos(lns::lns_t<I, F, A> x)
+{
+    const LnsTrigTables<I, F, A>& t = LnsTrigTables<I, F, A>::get();
+    lns::lns_t<I, F, A> a = x.abs();
+    if(a <= t.half)
+        return t.halfPi - lnsAsinKernel(x, t);
+    if(a > t.one)
+        a = t.one;
+
+    // acos(a) = 2 * asin(sqrt((1 - a) / 2)) and acos(-a) = PI - acos(a)
+    lns::lns_t<I, F, A> r = t.two * lnsAsinKernel(((t.one - a) * t.half).sqrt(), t);
+    return x.isNegative() ? t.pi - r : r;
+}
+
+#endif
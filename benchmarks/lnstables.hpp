@@ -0,0 +1,115 @@
+#ifndef LNS_TABLES_HPP
+#define LNS_TABLES_HPP
+
+// Exhaustive lookup tables for the unary functions of small LNS types.
+// A lns_t stored in at most 16 bits has at most 65536 bit patterns, so every unary function
+// can be tabulated with correctly rounded results (computed through double). Tables are built
+// on first use and indexed by the bit pattern of the argument.
+// Enabled by compiling with -DLNS_UNARY_TABLES, the utilities select them automatically.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+#include "../lns.hpp"
+
+#ifdef LNS_UNARY_TABLES
+#define LNS_UNARY_TABLES_ENABLED true
+#else
+#define LNS_UNARY_TABLES_ENABLED false
+#endif
+
+enum LnsUnaryFunction
+{
+    LNS_SQRT,
+    LNS_LOG,
+    LNS_EXP,
+    LNS_SIN,
+    LNS_COS,
+    LNS_ASIN,
+    LNS_ACOS
+};
+
+template<typename L>
+struct LnsTableEligible : std::integral_constant<bool, LNS_UNARY_TABLES_ENABLED && sizeof(L) <= 2 &&
+                                                       std::is_trivially_copyable<L>::value>
+{
+};
+
+// total memory used by the tables built so far, tables of different functions can be built at
+// the same time by worker threads
+std::atomic<size_t>& lnsTableMemory()
+{
+    static std::atomic<size_t> bytes(0);
+    return bytes;
+}
+
+template<typename L>
+uint16_t lnsBits(L value)
+{
+    uint16_t bits = 0;
+    std::memcpy(&bits, &value, std::min(sizeof(L), sizeof(bits)));
+    return bits;
+}
+
+template<typename L>
+L lnsFromBits(uint16_t bits)
+{
+    L value;
+    std::memcpy(static_cast<void*>(&value), &bits, std::min(sizeof(L), sizeof(bits)));
+    return value;
+}
+
+template<int Function>
+double lnsUnaryReference(double x)
+{
+    switch(Function)
+    {
+        case LNS_SQRT: return std::sqrt(x);
+        case LNS_LOG: return std::log(x);
+        case LNS_EXP: return std::exp(x);
+        case LNS_SIN: return std::sin(x);
+        case LNS_COS: return std::cos(x);
+        case LNS_ASIN: return std::asin(std::min(1.0, std::max(-1.0, x)));
+        default: return std::acos(std::min(1.0, std::max(-1.0, x)));
+    }
+}
+
+template<typename L, int Function>
+const std::vector<L>& lnsUnaryTable()
+{
+    static const std::vector<L> table = []() {
+        size_t size = (size_t)1 << (8 * std::min(sizeof(L), sizeof(uint16_t)));
+        std::vector<L> t;
+        t.reserve(size);
+        for(size_t bits = 0; bits < size; ++bits)
+            t.emplace_back(lnsUnaryReference<Function>((double)lnsFromBits<L>((uint16_t)bits)));
+        lnsTableMemory() += size * sizeof(L);
+        return t;
+    }();
+    return table;
+}
+
+template<int Function, typename L, typename Fallback>
+L lnsUnary(L value, const Fallback&, std::true_type)
+{
+    return lnsUnaryTable<L, Function>()[lnsBits(value)];
+}
+
+template<int Function, typename L, typename Fallback>
+L lnsUnary(L value, const Fallback& fallback, std::false_type)
+{
+    return fallback(value);
+}
+
+// table lookup when enabled and the type is small enough, fallback(value) otherwise
+template<int Function, typename L, typename Fallback>
+L lnsUnary(L value, const Fallback& fallback)
+{
+    return lnsUnary<Function>(value, fallback, LnsTableEligible<L>());
+}
+
+#endif
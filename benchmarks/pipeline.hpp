@@ -0,0 +1,170 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+// Frame pipeline of the video modes: a load stage, a compute stage and an export stage run on
+// their own threads and pass frames through bounded queues, so that a frame is computed while
+// the next one is converted and the previous one exported. Frames come from a pool of
+// PIPELINE_DEPTH frames recycled by the export stage, which bounds the memory used and makes
+// the load stage wait when the later stages fall behind, as a capture device would.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "planarimage.hpp"
+
+// number of frames of the video modes and number of frames in flight in their pipelines
+#ifndef VIDEO_FRAMES
+#define VIDEO_FRAMES 32
+#endif
+
+#ifndef PIPELINE_DEPTH
+#define PIPELINE_DEPTH 4
+#endif
+
+// FIFO of at most capacity items between two threads
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false)
+    {
+    }
+
+    // waits until there is room for the item
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this]() { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    // waits for an item, returns false once the queue is closed and empty
+    bool pop(T* item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this]() { return !items.empty() || closed; });
+        if(items.empty())
+            return false;
+
+        *item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // no item will be pushed anymore
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+};
+
+template<typename T>
+struct VideoFrame
+{
+    int index;
+    std::chrono::steady_clock::time_point start;   // when the load stage took the frame
+    PlanarImage<T> image;
+    PlanarImage<T> result;
+    std::vector<int> output;
+};
+
+// prints the frame rate of a pipeline and the percentiles of its frame latencies
+void printFrameStatistics(const std::string& name, std::vector<long long int> latencies, long long int microseconds)
+{
+    if(latencies.empty())
+        return;
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        size_t rank = (size_t)std::ceil(p * latencies.size());
+        return latencies[std::min(latencies.size(), std::max(rank, (size_t)1)) - 1] / 1000.0;
+    };
+
+    std::cout << std::setprecision(10);
+    std::cout << name << ": " << (latencies.size() * 1e6 / std::max(microseconds, 1LL)) << " frames/s ("
+              << (microseconds / 1000.0) << " ms for " << latencies.size() << " frames)" << std::endl;
+    std::cout << "Frame latency: p50 " << percentile(0.5) << " ms, p90 " << percentile(0.9) << " ms, p99 "
+              << percentile(0.99) << " ms, max " << latencies.back() / 1000.0 << " ms" << std::endl;
+}
+
+// runs frames through load(frame), compute(frame) and exportFrame(frame), each stage on its own
+// thread, and returns the output of the last frame
+template<typename T, typename Load, typename Compute, typename Export>
+std::vector<int> runPipeline(const std::string& name, int frames, const Load& load, const Compute& compute, const Export& exportFrame)
+{
+    typedef std::unique_ptr<VideoFrame<T> > FramePointer;
+    BoundedQueue<FramePointer> freeFrames(PIPELINE_DEPTH);
+    BoundedQueue<FramePointer> loadedFrames(PIPELINE_DEPTH);
+    BoundedQueue<FramePointer> computedFrames(PIPELINE_DEPTH);
+    for(int i = 0; i < PIPELINE_DEPTH; ++i)
+        freeFrames.push(FramePointer(new VideoFrame<T>()));
+
+    std::vector<long long int> latencies;
+    latencies.reserve(frames);
+    std::vector<int> output;
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::thread loader([&]() {
+        for(int i = 0; i < frames; ++i)
+        {
+            FramePointer frame;
+            freeFrames.pop(&frame);
+            frame->index = i;
+            frame->start = std::chrono::steady_clock::now();
+            load(*frame);
+            loadedFrames.push(std::move(frame));
+        }
+        loadedFrames.close();
+    });
+
+    std::thread computer([&]() {
+        FramePointer frame;
+        while(loadedFrames.pop(&frame))
+        {
+            compute(*frame);
+            computedFrames.push(std::move(frame));
+        }
+        computedFrames.close();
+    });
+
+    // the calling thread is the export stage
+    FramePointer frame;
+    while(computedFrames.pop(&frame))
+    {
+        exportFrame(*frame);
+        latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - frame->start).count());
+        if(frame->index == frames - 1)
+            output.swap(frame->output);
+        freeFrames.push(std::move(frame));
+    }
+
+    loader.join();
+    computer.join();
+    auto endTime = std::chrono::steady_clock::now();
+
+    printFrameStatistics(name, latencies, std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
+    return output;
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef PLANARIMAGE_HPP
+#define PLANARIMAGE_HPP
+
+// Image stored in one aligned allocation with planar R, G and B channels, and optional side
+// planes for per-pixel labels and distances. Every plane uses the same row stride, rows start
+// on cache line boundaries when the element size allows it, so there is no per-pixel padding
+// or indirection whatever the size of T.
+
+#include <cstdlib>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "batch.hpp"
+
+#define IMAGE_ALIGNMENT 64
+
+template<typename T>
+struct PlanarImage
+{
+    int width;
+    int height;
+    int stride;             // elements from the start of a row to the start of the next one
+    T* channels[3];         // R, G and B planes
+    int* labels;            // side planes, nullptr unless requested at allocation
+    T* distances;
+    std::string meta;
+
+    PlanarImage() : width(0), height(0), stride(0), channels{nullptr, nullptr, nullptr},
+                    labels(nullptr), distances(nullptr), buffer(nullptr), planes(0)
+    {
+    }
+
+    PlanarImage(const PlanarImage&) = delete;
+    PlanarImage& operator=(const PlanarImage&) = delete;
+
+    ~PlanarImage()
+    {
+        release();
+    }
+
+    // allocates the planes of a width x height image, initialized to zero
+    bool allocate(int w, int h, bool withLabels = false, bool withDistances = false)
+    {
+        release();
+
+        size_t lineElements = IMAGE_ALIGNMENT % sizeof(T) == 0 ? IMAGE_ALIGNMENT / sizeof(T) : 1;
+        size_t rowElements = (w + lineElements - 1) / lineElements * lineElements;
+        size_t planeElements = rowElements * h;
+        int valuePlanes = withDistances ? 4 : 3;
+        size_t valueBytes = (valuePlanes * planeElements * sizeof(T) + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+        size_t labelBytes = withLabels ? planeElements * sizeof(int) : 0;
+
+        buffer = malloc(valueBytes + labelBytes + IMAGE_ALIGNMENT);
+        if(buffer == nullptr)
+            return false;
+
+        T* values = (T*)(((uintptr_t)buffer + IMAGE_ALIGNMENT - 1) & ~(uintptr_t)(IMAGE_ALIGNMENT - 1));
+        std::uninitialized_fill_n(values, valuePlanes * planeElements, T(0));
+
+        width = w;
+        height = h;
+        stride = (int)rowElements;
+        planes = valuePlanes * planeElements;
+        for(int c = 0; c < 3; ++c)
+            channels[c] = values + c * planeElements;
+        distances = withDistances ? values + 3 * planeElements : nullptr;
+        labels = withLabels ? (int*)((char*)values + valueBytes) : nullptr;
+        if(labels != nullptr)
+            std::uninitialized_fill_n(labels, planeElements, 0);
+
+        return true;
+    }
+
+    void release()
+    {
+        if(buffer == nullptr)
+            return;
+
+        for(size_t i = 0; i < planes; ++i)
+            channels[0][i].~T();
+        free(buffer);
+
+        width = height = stride = 0;
+        channels[0] = channels[1] = channels[2] = nullptr;
+        labels = nullptr;
+        distances = nullptr;
+        buffer = nullptr;
+        planes = 0;
+    }
+
+    T* row(int channel, int y) const
+    {
+        return channels[channel] + (size_t)y * stride;
+    }
+
+    int* labelRow(int y) const
+    {
+        return labels + (size_t)y * stride;
+    }
+
+    T* distanceRow(int y) const
+    {
+        return distances + (size_t)y * stride;
+    }
+
+private:
+    void* buffer;
+    size_t planes;          // number of constructed values
+};
+
+// exports the channels multiplied by scale as integers, 3 adjacent ints per pixel
+template<typename T>
+std::vector<int> exportPlanarImage(const PlanarImage<T>& image, T scale)
+{
+    std::vector<int> output(3 * (size_t)image.width * image.height);
+
+    // each row is scaled, then truncated to integers
+    std::vector<T> scaled(image.width);
+
+    for(int y = 0; y < image.height; y++) {
+        int* outputRow = &output[3 * (size_t)y * image.width];
+        for(int c = 0; c < 3; c++) {
+            batchMul(image.row(c, y), scale, scaled.data(), image.width);
+            for(int x = 0; x < image.width; x++)
+                outputRow[3 * x + c] = (int)scaled[x];
+        }
+    }
+
+    return output;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef REDUCTION_HPP
+#define REDUCTION_HPP
+
+// Sum and dot product primitives used by the benchmark kernels.
+// Every partial addition of LNS values is an approximate, table-based operation. With deferred
+// summation, LNS terms are accumulated in a double and converted back once, which rounds the
+// result once instead of at each addition. Adjacent LNS values differ by a ratio of 2^(2^-F), so
+// a double (53-bit mantissa) holds the terms more finely than the type only for F < 52: types
+// with more fractional bits, lns64_t included, keep summing term by term.
+// Enabled by compiling with -DLNS_DEFERRED_SUM, the kernels then select it automatically.
+
+#include <cstddef>
+#include <type_traits>
+#include "../lns.hpp"
+
+#ifdef LNS_DEFERRED_SUM
+#define LNS_DEFERRED_SUM_ENABLED true
+#else
+#define LNS_DEFERRED_SUM_ENABLED false
+#endif
+
+template<typename T, bool Deferred = LNS_DEFERRED_SUM_ENABLED>
+struct SumAccumulator
+{
+    T total = T(0);
+
+    void add(T value)
+    {
+        total += value;
+    }
+
+    // adds the terms of another accumulator, to merge partial sums
+    void merge(const SumAccumulator& other)
+    {
+        total += other.total;
+    }
+
+    T value() const
+    {
+        return total;
+    }
+};
+
+// zero terms are skipped since an LNS addition costs far more than the test
+template<int I, int F, int A, bool Deferred>
+struct SumAccumulator<lns::lns_t<I, F, A>, Deferred>
+{
+    using L = lns::lns_t<I, F, A>;
+    using Wide = typename std::conditional<Deferred && F < 52, double, L>::type;
+
+    Wide total = Wide(0);
+
+    void add(L value)
+    {
+        if(!value.isZero())
+            total += Wide(value);
+    }
+
+    void merge(const SumAccumulator& other)
+    {
+        total += other.total;
+    }
+
+    L value() const
+    {
+        return L(total);
+    }
+};
+
+template<typename T, bool Deferred = LNS_DEFERRED_SUM_ENABLED>
+T sum(const T* values, size_t n)
+{
+    SumAccumulator<T, Deferred> accumulator;
+    for(size_t i = 0; i < n; ++i)
+        accumulator.add(values[i]);
+    return accumulator.value();
+}
+
+template<int N, typename T, bool Deferred = LNS_DEFERRED_SUM_ENABLED>
+T dot(const T* a, const T* b)
+{
+    SumAccumulator<T, Deferred> accumulator;
+    for(int i = 0; i < N; ++i)
+        accumulator.add(a[i] * b[i]);
+    return accumulator.value();
+}
+
+#endif
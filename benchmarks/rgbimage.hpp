@@ -5,31 +5,8 @@
 #include <cstring>
 #include <cstdlib>
 #include <vector>
-
-template<typename T>
-struct RgbPixel {
-    T r;
-    T g;
-    T b;
-    int cluster;
-    T distance;
-};
-
-template<typename T>
-struct RgbImage {
-    int w;
-    int h;
-    RgbPixel<T>** pixels;
-    char* meta;
-};
-
-template<typename T>
-void initRgbImage(RgbImage<T>* image) {
-    image->w = 0;
-    image->h = 0;
-    image->pixels = nullptr;
-    image->meta = nullptr;
-}
+#include "batch.hpp"
+#include "planarimage.hpp"
 
 int readCell(FILE *fp, char* w) {
     int c;
@@ -55,13 +32,14 @@ int readCell(FILE *fp, char* w) {
     return c;
 }
 
+// loads the image with its channels divided by scale, with label and distance planes
 template<typename T>
-int loadRgbImage(const char* fileName, RgbImage<T>* image, T scale) {
+int loadRgbImage(const char* fileName, PlanarImage<T>* image, T scale) {
     int c;
     int i;
     int j;
+    int width, height;
     char w[256];
-    RgbPixel<T>** pixels;
     FILE *fp;
 
     //printf("Loading %s ...\n", fileName);
@@ -73,15 +51,13 @@ int loadRgbImage(const char* fileName, RgbImage<T>* image, T scale) {
     }
 
     c = readCell(fp, w);
-    image->w = atoi(w);
+    width = atoi(w);
     c = readCell(fp, w);
-    image->h = atoi(w);
-
-    //printf("%d x %d\n", image->w, image->h);
+    height = atoi(w);
 
-    pixels = (RgbPixel<T>**)malloc(image->h * sizeof(RgbPixel<T>*));
+    //printf("%d x %d\n", width, height);
 
-    if (pixels == nullptr) {
+    if (!image->allocate(width, height, true, true)) {
         printf("Warning: Oops! Cannot allocate memory for the pixels!\n");
 
         fclose(fp);
@@ -89,100 +65,38 @@ int loadRgbImage(const char* fileName, RgbImage<T>* image, T scale) {
         return 0;
     }
 
-    c = 0;
-    for(i = 0; i < image->h; i++) {
-        pixels[i] = (RgbPixel<T>*)malloc(image->w * sizeof(RgbPixel<T>));
-        if (pixels[i] == nullptr) {
-            c = 1;
-            break;
-        }
-    }
-
-    if (c == 1) {
-        printf("Warning: Oops! Cannot allocate memory for the pixels!\n");
+    // each row is parsed and split into the channel planes
+    std::vector<int> values(3 * width);
 
-        for (i--; i >= 0; i--)
-            free(pixels[i]);
-        free(pixels);
-
-        fclose(fp);
-
-        return 0;
-    }
-
-    for(i = 0; i < image->h; i++) {
-        for(j = 0; j < image->w; j++) {
+    for(i = 0; i < height; i++) {
+        for(j = 0; j < 3 * width; j++) {
             c = readCell(fp, w);
-            pixels[i][j].r = T(atoi(w)) / scale;
-
-            c = readCell(fp, w);
-            pixels[i][j].g = T(atoi(w)) / scale;
-
-            c = readCell(fp, w);
-            pixels[i][j].b = T(atoi(w)) / scale;
+            values[j] = atoi(w);
+        }
 
-            pixels[i][j].cluster = 0;
-            pixels[i][j].distance = T(0);
+        for(c = 0; c < 3; c++) {
+            T* row = image->row(c, i);
+            for(j = 0; j < width; j++)
+                row[j] = T(values[3 * j + c]);
+            batchDiv(row, scale, row, width);
         }
     }
-    image->pixels = pixels;
 
-    c = readCell(fp, w);
-    image->meta = (char*)malloc(strlen(w) * sizeof(char));
-    if(image->meta == nullptr) {
-        printf("Warning: Oops! Cannot allocate memory for the pixels!\n");
-
-        for (i = 0; i < image->h; i++)
-            free(pixels[i]);
-        free(pixels);
-
-        fclose(fp);
-
-        return 0;
+    readCell(fp, w);
+    image->meta = w;
 
-    }
-    strcpy(image->meta, w);
+    fclose(fp);
 
-    //printf("%s\n", image->meta);
+    //printf("%s\n", image->meta.c_str());
 
-    //printf("w=%d x h=%d\n", image->w, image->h);
+    //printf("w=%d x h=%d\n", width, height);
 
     return 1;
 }
 
 template<typename T>
-std::vector<int> exportRgbImage(RgbImage<T>* image, T scale) {
-    int i;
-    int j;
-
-    std::vector<int> output;
-
-    for(i = 0; i < image->h; i++) {
-        for(j = 0; j < image->w; j++) {
-            output.push_back((int)(image->pixels[i][j].r * scale));
-            output.push_back((int)(image->pixels[i][j].g * scale));
-            output.push_back((int)(image->pixels[i][j].b * scale));
-        }
-    }
-
-    return output;
-}
-
-template<typename T>
-void freeRgbImage(RgbImage<T>* image) {
-    int i;
-
-    if (image->meta != nullptr)
-        free(image->meta);
-
-    if (image->pixels == nullptr)
-        return;
-
-    for (i = 0; i < image->h; i++)
-        if (image->pixels != nullptr)
-            free(image->pixels[i]);
-
-    free(image->pixels);
+std::vector<int> exportRgbImage(const PlanarImage<T>& image, T scale) {
+    return exportPlanarImage(image, scale);
 }
 
-#endif
+#endif
\ No newline at end of file
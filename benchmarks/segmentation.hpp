@@ -1,8 +1,15 @@
 #ifndef SEGMENTATION_HPP
 #define SEGMENTATION_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
 #include "rgbimage.hpp"
 #include "utilities.hpp"
+#include "reduction.hpp"
+#include "batch.hpp"
+#include "threading.hpp"
 
 template<typename T>
 struct Centroid {
@@ -18,40 +25,21 @@ struct Clusters {
     Centroid<T>* centroids;
 };
 
+// assigns n pixels of a row to their closest centroid; only the order of the distances
+// matters, so distances holds the squared distances and no square root is computed. The
+// distances to each centroid are computed and compared on the channel planes with the batch
+// kernels, the labels are written to their own plane
 template<typename T>
-T euclideanDistance(RgbPixel<T>* p, Centroid<T>* c1) {
-    T r(0);
-
-    r += (p->r - c1->r) * (p->r - c1->r);
-    r += (p->g - c1->g) * (p->g - c1->g);
-    r += (p->b - c1->b) * (p->b - c1->b);
-
-    return squareRoot(r);
-}
-
-template<typename T>
-int pickCluster(RgbPixel<T>* p, Centroid<T>* c1) {
-    T d1(euclideanDistance(p, c1));
-
-    if (p->distance <= d1)
-        return 0;
-
-    return 1;
-}
-
-template<typename T>
-void assignCluster(RgbPixel<T>* p, Clusters<T>* clusters) {
-    int i = 0;
+void assignClusters(const T* r, const T* g, const T* b, int* labels, T* distances, int n, Clusters<T>* clusters) {
+    int c;
+    std::vector<T> d(n);
 
-    T d(euclideanDistance(p, &clusters->centroids[i]));
-    p->distance = d;
+    std::fill(labels, labels + n, 0);
+    batchSquaredDistance(r, g, b, clusters->centroids[0].r, clusters->centroids[0].g, clusters->centroids[0].b, distances, n);
 
-    for(i = 1; i < clusters->k; ++i) {
-        d = euclideanDistance(p, &clusters->centroids[i]);
-        if (d < p->distance) {
-            p->cluster = i;
-            p->distance = d;
-        }
+    for (c = 1; c < clusters->k; ++c) {
+        batchSquaredDistance(r, g, b, clusters->centroids[c].r, clusters->centroids[c].g, clusters->centroids[c].b, d.data(), n);
+        batchMinIndex(d.data(), c, distances, labels, n);
     }
 }
 
@@ -63,6 +51,7 @@ int initClusters(Clusters<T>* clusters, int k, T scale) {
 
     if (clusters->centroids == nullptr) {
         printf("Warning: Oops! Cannot allocate memory for the clusters!\n");
+        clusters->k = 0;
 
         return 0;
     }
@@ -91,51 +80,383 @@ void freeClusters(Clusters<T>* clusters) {
         free(clusters->centroids);
 }
 
+// maximum number of Lloyd iterations, and centroid shift (in channel units divided by 256)
+// below which the centroids are considered converged
+#ifndef KMEANS_ITERATIONS
+#define KMEANS_ITERATIONS 20
+#endif
+
+#if KMEANS_ITERATIONS < 1
+#error "KMEANS_ITERATIONS must be at least 1"
+#endif
+
+#ifndef KMEANS_THRESHOLD
+#define KMEANS_THRESHOLD 0.001
+#endif
+
+// assignment algorithms: Lloyd computes the distances of every pixel to every centroid, Hamerly
+// and Elkan keep bounds on the distances of each pixel from one iteration to the next and skip
+// the distances that the triangle inequality proves useless, with one lower bound per pixel for
+// Hamerly and one per pixel and centroid for Elkan
+enum KmeansAlgorithm { KMEANS_LLOYD, KMEANS_HAMERLY, KMEANS_ELKAN };
+
+const char* kmeansAlgorithmName(KmeansAlgorithm algorithm) {
+    static const char* names[] = {"Lloyd", "Hamerly", "Elkan"};
+    return names[algorithm];
+}
+
+#ifndef KMEANS_ALGORITHM
+#define KMEANS_ALGORITHM KMEANS_LLOYD
+#endif
+
+#ifndef KMEANS_CLUSTERS
+#define KMEANS_CLUSTERS 6
+#endif
+
+// channel sums and pixel count of each cluster over the rows of one thread, and the number of
+// pixel to centroid distances computed
 template<typename T>
-void segmentImage(RgbImage<T>* image, Clusters<T>* clusters, int n) {
-    int i;
-    int x, y;
-    int c;
+struct ClusterSums {
+    std::vector<SumAccumulator<T> > sums;
+    std::vector<int> n;
+    uint64_t distances;
+
+    explicit ClusterSums(int k) : sums(3 * k), n(k, 0), distances(0) {
+    }
+};
+
+template<typename T>
+void accumulateRow(const T* r, const T* g, const T* b, const int* labels, int width, ClusterSums<T>* partial) {
+    int x, c;
 
-    for (i = 0; i < n; ++i) {
-        for (y = 0; y < image->h; y++) {
-            for (x = 0; x < image->w; x++) {
-                assignCluster(&image->pixels[y][x], clusters);
+    for (x = 0; x < width; x++) {
+        c = labels[x];
+        partial->sums[3 * c].add(r[x]);
+        partial->sums[3 * c + 1].add(g[x]);
+        partial->sums[3 * c + 2].add(b[x]);
+        partial->n[c] += 1;
+    }
+}
+
+// assigns the rows [begin, end) and accumulates them into the sums of their clusters
+template<typename T>
+void assignRows(PlanarImage<T>* image, Clusters<T>* clusters, int begin, int end, ClusterSums<T>* partial) {
+    int y;
+
+    for (y = begin; y < end; y++) {
+        assignClusters(image->row(0, y), image->row(1, y), image->row(2, y),
+                       image->labelRow(y), image->distanceRow(y), image->width, clusters);
+        accumulateRow(image->row(0, y), image->row(1, y), image->row(2, y), image->labelRow(y), image->width, partial);
+        partial->distances += (uint64_t)image->width * clusters->k;
+    }
+}
+
+template<typename T>
+T centroidDistance(T r, T g, T b, const Centroid<T>& centroid) {
+    return squareRoot(square(r - centroid.r) + square(g - centroid.g) + square(b - centroid.b));
+}
+
+// distance bounds of Hamerly and Elkan, pixels are indexed by y * width + x; the bounds hold
+// true distances, since their updates by the centroid moves rely on the triangle inequality
+template<typename T>
+struct KmeansBounds {
+    KmeansAlgorithm algorithm;
+    int k;
+    bool initialized;
+    std::vector<T> upper;           // distance to the assigned centroid
+    std::vector<T> lower;           // to the second closest centroid (Hamerly), to each centroid (Elkan)
+    std::vector<T> moves;           // distance moved by each centroid at the last update
+    std::vector<T> halfDistances;   // half distances between centroids, k x k
+    std::vector<T> halfNearest;     // half distance from each centroid to its closest other one
+    T maxMove;                      // largest and second largest moves
+    T secondMove;
+
+    KmeansBounds(KmeansAlgorithm a, int clusters, size_t pixels) : algorithm(a), k(clusters), initialized(false),
+        upper(pixels), lower(a == KMEANS_ELKAN ? pixels * clusters : pixels), moves(clusters, T(0)),
+        halfDistances((size_t)clusters * clusters), halfNearest(clusters), maxMove(0), secondMove(0) {
+    }
+
+    // distances between the centroids, before an assignment
+    void updateCentroids(const Clusters<T>* clusters) {
+        int c, d;
+        const T half(0.5);
+
+        for (c = 0; c < k; ++c) {
+            halfDistances[c * k + c] = T(0);
+            for (d = 0; d < c; ++d) {
+                const Centroid<T>& other = clusters->centroids[d];
+                T distance = half * centroidDistance(clusters->centroids[c].r, clusters->centroids[c].g, clusters->centroids[c].b, other);
+                halfDistances[c * k + d] = distance;
+                halfDistances[d * k + c] = distance;
             }
         }
+        for (c = 0; c < k; ++c) {
+            halfNearest[c] = k > 1 ? halfDistances[c * k + (c == 0 ? 1 : 0)] : T(0);
+            for (d = 0; d < k; ++d)
+                if (d != c && halfDistances[c * k + d] < halfNearest[c])
+                    halfNearest[c] = halfDistances[c * k + d];
+        }
+    }
 
-        /** Recenter */
-        for (c  = 0; c < clusters->k; ++c) {
-            clusters->centroids[c].r = T(0);
-            clusters->centroids[c].g = T(0);
-            clusters->centroids[c].b = T(0);
-            clusters->centroids[c].n = 0;
+    // moves of the centroids, after an update
+    void setMove(int c, T move) {
+        moves[c] = move;
+        if (c == 0)
+            maxMove = secondMove = T(0);
+        if (move > maxMove) {
+            secondMove = maxMove;
+            maxMove = move;
         }
-        for (y = 0; y < image->h; y++) {
-            for (x = 0; x < image->w; x++) {
-                clusters->centroids[image->pixels[y][x].cluster].r += image->pixels[y][x].r;
-                clusters->centroids[image->pixels[y][x].cluster].g += image->pixels[y][x].g;
-                clusters->centroids[image->pixels[y][x].cluster].b += image->pixels[y][x].b;
-                clusters->centroids[image->pixels[y][x].cluster].n += 1;
+        else if (move > secondMove) {
+            secondMove = move;
+        }
+    }
+};
+
+// Hamerly assignment of one row: a pixel keeps its centroid when its upper bound is below both
+// its lower bound and half the distance from its centroid to the closest other one
+template<typename T>
+void assignRowHamerly(const T* r, const T* g, const T* b, int* labels, int width, size_t offset,
+                      const Clusters<T>* clusters, KmeansBounds<T>* bounds, uint64_t* count) {
+    int x, c;
+
+    for (x = 0; x < width; x++) {
+        T& upper = bounds->upper[offset + x];
+        T& lower = bounds->lower[offset + x];
+        int a = labels[x];
+
+        if (bounds->initialized) {
+            upper += bounds->moves[a];
+            lower -= bounds->moves[a] == bounds->maxMove ? bounds->secondMove : bounds->maxMove;
+
+            T limit = lower > bounds->halfNearest[a] ? lower : bounds->halfNearest[a];
+            if (upper <= limit)
+                continue;
+
+            upper = centroidDistance(r[x], g[x], b[x], clusters->centroids[a]);
+            ++*count;
+            if (upper <= limit)
+                continue;
+        }
+        else {
+            a = 0;
+            upper = centroidDistance(r[x], g[x], b[x], clusters->centroids[0]);
+            ++*count;
+        }
+
+        // closest and second closest centroids
+        T second(0);
+        bool hasSecond = false;
+        for (c = 0; c < clusters->k; ++c) {
+            if (c == a)
+                continue;
+            T distance = centroidDistance(r[x], g[x], b[x], clusters->centroids[c]);
+            ++*count;
+            if (distance < upper) {
+                second = upper;
+                upper = distance;
+                a = c;
+            }
+            else if (!hasSecond || distance < second) {
+                second = distance;
             }
+            hasSecond = true;
+        }
+        labels[x] = a;
+        lower = second;
+    }
+}
+
+// Elkan assignment of one row: the distance to a centroid is only computed when the upper bound
+// exceeds both the lower bound of that centroid and half its distance to the assigned one
+template<typename T>
+void assignRowElkan(const T* r, const T* g, const T* b, int* labels, int width, size_t offset,
+                    const Clusters<T>* clusters, KmeansBounds<T>* bounds, uint64_t* count) {
+    int x, c;
+    const int k = clusters->k;
+    const T zero(0);
+
+    for (x = 0; x < width; x++) {
+        T& upper = bounds->upper[offset + x];
+        T* lower = &bounds->lower[(offset + x) * k];
+        int a = labels[x];
+
+        if (!bounds->initialized) {
+            a = 0;
+            for (c = 0; c < k; ++c) {
+                lower[c] = centroidDistance(r[x], g[x], b[x], clusters->centroids[c]);
+                if (c == 0 || lower[c] < upper) {
+                    upper = lower[c];
+                    a = c;
+                }
+            }
+            *count += k;
+            labels[x] = a;
+            continue;
+        }
+
+        upper += bounds->moves[a];
+        for (c = 0; c < k; ++c) {
+            lower[c] -= bounds->moves[c];
+            if (lower[c] < zero)
+                lower[c] = zero;
         }
-        for (c  = 0; c < clusters->k; ++c) {
-            if (clusters->centroids[c].n != 0) {
-                T nVal(clusters->centroids[c].n);
-                clusters->centroids[c].r = clusters->centroids[c].r / nVal;
-                clusters->centroids[c].g = clusters->centroids[c].g / nVal;
-                clusters->centroids[c].b = clusters->centroids[c].b / nVal;
+
+        if (upper <= bounds->halfNearest[a])
+            continue;
+
+        bool stale = true;
+        for (c = 0; c < k; ++c) {
+            if (c == a || upper <= lower[c] || upper <= bounds->halfDistances[a * k + c])
+                continue;
+
+            if (stale) {
+                upper = centroidDistance(r[x], g[x], b[x], clusters->centroids[a]);
+                lower[a] = upper;
+                ++*count;
+                stale = false;
+                if (upper <= lower[c] || upper <= bounds->halfDistances[a * k + c])
+                    continue;
+            }
+
+            lower[c] = centroidDistance(r[x], g[x], b[x], clusters->centroids[c]);
+            ++*count;
+            if (lower[c] < upper) {
+                upper = lower[c];
+                a = c;
             }
         }
+        labels[x] = a;
     }
+}
+
+// assigns the rows [begin, end) with the bounds, and accumulates them into the sums of their clusters
+template<typename T>
+void assignRowsBounded(PlanarImage<T>* image, Clusters<T>* clusters, KmeansBounds<T>* bounds, int begin, int end, ClusterSums<T>* partial) {
+    int y;
+
+    for (y = begin; y < end; y++) {
+        size_t offset = (size_t)y * image->width;
+        if (bounds->algorithm == KMEANS_HAMERLY)
+            assignRowHamerly(image->row(0, y), image->row(1, y), image->row(2, y), image->labelRow(y), image->width,
+                             offset, clusters, bounds, &partial->distances);
+        else
+            assignRowElkan(image->row(0, y), image->row(1, y), image->row(2, y), image->labelRow(y), image->width,
+                           offset, clusters, bounds, &partial->distances);
+        accumulateRow(image->row(0, y), image->row(1, y), image->row(2, y), image->labelRow(y), image->width, partial);
+    }
+}
+
+// merges the partial sums of the threads into the first ones
+template<typename T>
+void mergeSums(std::vector<ClusterSums<T> >* partial) {
+    size_t t;
+    int c;
+    ClusterSums<T>& total = (*partial)[0];
 
-    for (y = 0; y < image->h; y++) {
-        for (x = 0; x < image->w; x++) {
-            image->pixels[y][x].r = clusters->centroids[image->pixels[y][x].cluster].r;
-            image->pixels[y][x].g = clusters->centroids[image->pixels[y][x].cluster].g;
-            image->pixels[y][x].b = clusters->centroids[image->pixels[y][x].cluster].b;
+    for (t = 1; t < partial->size(); ++t) {
+        for (c = 0; c < (int)total.sums.size(); ++c)
+            total.sums[c].merge((*partial)[t].sums[c]);
+        for (c = 0; c < (int)total.n.size(); ++c)
+            total.n[c] += (*partial)[t].n[c];
+        total.distances += (*partial)[t].distances;
+    }
+}
+
+// moves each centroid to the mean of its pixels, records the moves in the bounds when they are
+// given, and returns the largest squared move
+template<typename T>
+T recenter(Clusters<T>* clusters, const ClusterSums<T>& total, KmeansBounds<T>* bounds = nullptr) {
+    int c;
+    T shift(0);
+
+    for (c  = 0; c < clusters->k; ++c) {
+        Centroid<T> previous = clusters->centroids[c];
+        clusters->centroids[c].n = total.n[c];
+        if (clusters->centroids[c].n != 0) {
+            T nVal(clusters->centroids[c].n);
+            clusters->centroids[c].r = total.sums[3 * c].value() / nVal;
+            clusters->centroids[c].g = total.sums[3 * c + 1].value() / nVal;
+            clusters->centroids[c].b = total.sums[3 * c + 2].value() / nVal;
         }
+        else {
+            clusters->centroids[c].r = T(0);
+            clusters->centroids[c].g = T(0);
+            clusters->centroids[c].b = T(0);
+        }
+
+        T distance = square(clusters->centroids[c].r - previous.r) + square(clusters->centroids[c].g - previous.g)
+                     + square(clusters->centroids[c].b - previous.b);
+        if (distance > shift)
+            shift = distance;
+        if (bounds != nullptr)
+            bounds->setMove(c, squareRoot(distance));
     }
+    return shift;
+}
+
+// runs k-means iterations until the largest centroid shift is below threshold or n iterations
+// are done, and returns the number of iterations; each thread assigns a contiguous range of
+// rows and accumulates it in its own sums, merged once per iteration. The number of pixel to
+// centroid distances computed is added to distanceCount, and whether the shift went below the
+// threshold is stored in converged, when they are given
+template<typename T>
+int segmentImage(PlanarImage<T>* image, Clusters<T>* clusters, int n, double threshold, int nThreads,
+                 KmeansAlgorithm algorithm = KMEANS_ALGORITHM, uint64_t* distanceCount = nullptr, bool* converged = nullptr) {
+    int i;
+    int x, y;
+    bool belowThreshold = false;
+    const T squaredThreshold = square(T(threshold));
+    std::unique_ptr<KmeansBounds<T> > bounds;
+    if (algorithm != KMEANS_LLOYD)
+        bounds.reset(new KmeansBounds<T>(algorithm, clusters->k, (size_t)image->width * image->height));
+
+    for (i = 0; i < n; ) {
+        if (bounds)
+            bounds->updateCentroids(clusters);
+
+        std::vector<ClusterSums<T> > partial(nThreads, ClusterSums<T>(clusters->k));
+        runThreads(nThreads, [image, clusters, nThreads, &partial, &bounds](int tid) {
+            int begin = image->height * tid / nThreads;
+            int end = image->height * (tid + 1) / nThreads;
+            if (bounds)
+                assignRowsBounded(image, clusters, bounds.get(), begin, end, &partial[tid]);
+            else
+                assignRows(image, clusters, begin, end, &partial[tid]);
+        });
+
+        /** Recenter */
+        mergeSums(&partial);
+        if (distanceCount != nullptr)
+            *distanceCount += partial[0].distances;
+
+        T shift = recenter(clusters, partial[0], bounds.get());
+        if (bounds)
+            bounds->initialized = true;
+
+        ++i;
+        if (shift < squaredThreshold) {
+            belowThreshold = true;
+            break;
+        }
+    }
+
+    if (converged != nullptr)
+        *converged = belowThreshold;
+
+    for (y = 0; y < image->height; y++) {
+        T* r = image->row(0, y);
+        T* g = image->row(1, y);
+        T* b = image->row(2, y);
+        const int* labels = image->labelRow(y);
+        for (x = 0; x < image->width; x++) {
+            r[x] = clusters->centroids[labels[x]].r;
+            g[x] = clusters->centroids[labels[x]].g;
+            b[x] = clusters->centroids[labels[x]].b;
+        }
+    }
+
+    return i;
 }
 
 #endif
\ No newline at end of file
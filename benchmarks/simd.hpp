@@ -0,0 +1,182 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// Portable SIMD wrapper built on the GCC/Clang vector extensions: the compiler maps the
+// vectors to SSE2, AVX2 or AVX-512 registers depending on the target flags (-march=...).
+// Only float and double have vector kernels, define NO_SIMD to disable them.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX512F__)
+#define SIMD_BYTES 64
+#elif defined(__AVX__)
+#define SIMD_BYTES 32
+#else
+#define SIMD_BYTES 16
+#endif
+
+template<typename S>
+struct SimdTraits;
+
+template<>
+struct SimdTraits<float>
+{
+    typedef float vector __attribute__((vector_size(SIMD_BYTES)));
+    typedef int32_t mask __attribute__((vector_size(SIMD_BYTES)));
+    typedef int32_t bits;
+    static const int mantissaBits = 23;
+    static const int exponentBias = 127;
+    static const int expTerms = 10;     // Taylor terms of exp on [0, ln2)
+    static const int logTerms = 4;      // odd terms of atanh in log
+    static constexpr float maxExp = 88.0f;
+    static constexpr float minExp = -87.0f;
+    static constexpr float ln2High = 0.693145751953125f;   // ln2 split so that n * ln2High is exact
+    static constexpr float ln2Low = 1.428606765330187e-06f;
+};
+
+template<>
+struct SimdTraits<double>
+{
+    typedef double vector __attribute__((vector_size(SIMD_BYTES)));
+    typedef int64_t mask __attribute__((vector_size(SIMD_BYTES)));
+    typedef int64_t bits;
+    static const int mantissaBits = 52;
+    static const int exponentBias = 1023;
+    static const int expTerms = 17;
+    static const int logTerms = 10;
+    static constexpr double maxExp = 709.0;
+    static constexpr double minExp = -708.0;
+    static constexpr double ln2High = 0.6931471803691238;
+    static constexpr double ln2Low = 1.9082149292705877e-10;
+};
+
+#define SIMD_VECTOR(S) typename SimdTraits<S>::vector
+#define SIMD_MASK(S) typename SimdTraits<S>::mask
+#define SIMD_WIDTH(S) (int)(SIMD_BYTES / sizeof(S))
+
+template<typename S>
+SIMD_VECTOR(S) simdSplat(S value)
+{
+    SIMD_VECTOR(S) v;
+    for(int i = 0; i < SIMD_WIDTH(S); ++i)
+        v[i] = value;
+    return v;
+}
+
+template<typename S>
+SIMD_VECTOR(S) simdLoad(const S* p)
+{
+    SIMD_VECTOR(S) v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template<typename S>
+void simdStore(S* p, SIMD_VECTOR(S) v)
+{
+    std::memcpy(p, &v, sizeof(v));
+}
+
+// lanes where mask is set take a, others take b
+template<typename S>
+SIMD_VECTOR(S) simdBlend(SIMD_MASK(S) mask, SIMD_VECTOR(S) a, SIMD_VECTOR(S) b)
+{
+    typedef SIMD_MASK(S) M;
+    typedef SIMD_VECTOR(S) V;
+    return (V)(((M)a & mask) | ((M)b & ~mask));
+}
+
+template<typename S>
+SIMD_VECTOR(S) simdAbs(SIMD_VECTOR(S) v)
+{
+    typedef SIMD_MASK(S) M;
+    typedef SIMD_VECTOR(S) V;
+    M signBit;
+    for(int i = 0; i < SIMD_WIDTH(S); ++i)
+        signBit[i] = (typename SimdTraits<S>::bits)1 << (sizeof(S) * 8 - 1);
+    return (V)((M)v & ~signBit);
+}
+
+template<typename S>
+SIMD_VECTOR(S) simdMin(SIMD_VECTOR(S) a, SIMD_VECTOR(S) b)
+{
+    return simdBlend<S>(a < b, a, b);
+}
+
+template<typename S>
+SIMD_VECTOR(S) simdMax(SIMD_VECTOR(S) a, SIMD_VECTOR(S) b)
+{
+    return simdBlend<S>(a > b, a, b);
+}
+
+// the lane loop compiles to a single sqrtps/sqrtpd
+template<typename S>
+SIMD_VECTOR(S) simdSqrt(SIMD_VECTOR(S) v)
+{
+    for(int i = 0; i < SIMD_WIDTH(S); ++i)
+        v[i] = std::sqrt(v[i]);
+    return v;
+}
+
+template<typename S>
+SIMD_VECTOR(S) simdFloor(SIMD_VECTOR(S) v)
+{
+    typedef SIMD_VECTOR(S) V;
+    typedef SIMD_MASK(S) M;
+    V t = __builtin_convertvector(__builtin_convertvector(v, M), V);
+    return simdBlend<S>(t > v, t - simdSplat<S>(1), t);
+}
+
+// exp(x) = 2^n * exp(r) with n = floor(x / ln2) and r in [0, ln2), the power of two is
+// written directly into the exponent bits of the result
+template<typename S>
+SIMD_VECTOR(S) simdExp(SIMD_VECTOR(S) x)
+{
+    typedef SimdTraits<S> Traits;
+    typedef typename Traits::vector V;
+    typedef typename Traits::mask M;
+
+    x = simdMin<S>(simdMax<S>(x, simdSplat<S>(Traits::minExp)), simdSplat<S>(Traits::maxExp));
+    V n = simdFloor<S>(x * simdSplat<S>((S)M_LOG2E));
+    V r = (x - n * simdSplat<S>(Traits::ln2High)) - n * simdSplat<S>(Traits::ln2Low);
+
+    // Horner evaluation of the Taylor series, 1 + r(1 + r/2(1 + r/3(...)))
+    V p = simdSplat<S>(1);
+    for(int i = Traits::expTerms; i > 0; --i)
+        p = simdSplat<S>(1) + p * r * simdSplat<S>((S)1 / i);
+
+    M e = __builtin_convertvector(n, M) + (typename Traits::bits)Traits::exponentBias;
+    return p * (V)(e << Traits::mantissaBits);
+}
+
+// log(x) = e * ln2 + log(m) with m in [sqrt(2)/2, sqrt(2)), log(m) = 2 * atanh((m - 1) / (m + 1)),
+// x must be positive and finite
+template<typename S>
+SIMD_VECTOR(S) simdLog(SIMD_VECTOR(S) x)
+{
+    typedef SimdTraits<S> Traits;
+    typedef typename Traits::vector V;
+    typedef typename Traits::mask M;
+    typedef typename Traits::bits B;
+
+    const B mantissaMask = ((B)1 << Traits::mantissaBits) - 1;
+    M bits = (M)x;
+    M e = (bits >> Traits::mantissaBits) - (B)Traits::exponentBias;
+    V m = (V)((bits & mantissaMask) | ((B)Traits::exponentBias << Traits::mantissaBits));
+
+    M big = m > simdSplat<S>((S)M_SQRT2);
+    m = simdBlend<S>(big, m * simdSplat<S>((S)0.5), m);
+    e = e - big;  // comparison masks are -1 where true
+
+    V s = (m - simdSplat<S>(1)) / (m + simdSplat<S>(1));
+    V s2 = s * s;
+    V p = simdSplat<S>((S)1 / (2 * Traits::logTerms + 1));
+    for(int i = Traits::logTerms - 1; i >= 0; --i)
+        p = simdSplat<S>((S)1 / (2 * i + 1)) + p * s2;
+
+    return __builtin_convertvector(e, V) * simdSplat<S>((S)M_LN2) + simdSplat<S>(2) * s * p;
+}
+
+#endif
@@ -10,283 +10,381 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
-#include <memory>
+#include <algorithm>
+#include <string>
 #include <fstream>
+#include <chrono>
 #include "utilities.hpp"
+#include "threading.hpp"
+#include "benchmarks.hpp"
+#include "batch.hpp"
+#include "planarimage.hpp"
 
-template<typename T>
-class Pixel {
-public:
-    Pixel (T r, T g, T b)
+// reads the "width,height" header of an image file
+bool readRgbHeader(std::istream& imageFile, int* width, int* height)
+{
+    imageFile >> *width;
+    imageFile.ignore();
+    imageFile >> *height;
+    imageFile.ignore();
+    return (bool)imageFile;
+}
+
+// reads the 3 * width comma-separated channel values of the next row
+void readRgbRow(std::istream& imageFile, double* values, int width)
+{
+    for(int i = 0 ; i < 3 * width ; i++)
     {
-        this->r = r ;
-        this->g = g ;
-        this->b = b ;
+        imageFile >> values[i];
+        imageFile.ignore();
     }
-    T r ;
-    T g ;
-    T b ;
-} ;
+}
 
+// loads a Sobel input file (comma-separated rows of RGB values, then a metadata line) into the
+// channel planes of an image; k-means images are loaded by loadRgbImage of rgbimage.hpp
 template<typename T>
-class Image {
-public:
-    int 			width ;
-    int 			height ;
-    std::vector 	<std::vector<std::shared_ptr<Pixel<T>> > > pixels ;
-    std::string 	meta ;
-
-    // Constructor
-    Image()
-    {
-        this->width  = 0 ;
-        this->height = 0 ;
-    }
+int loadSobelImage(const std::string& filename, PlanarImage<T>* image)
+{
+    std::ifstream imageFile ;
+    int width, height ;
 
-    int loadRgbImage (const std::string& filename)
+    imageFile.open(filename.c_str()) ;
+    if(! imageFile.is_open())
     {
-        std::ifstream imageFile ;
+        std::cerr << "# Error opening the file!" << std::endl ;
+        return 0 ;
+    }
 
-        imageFile.open(filename.c_str()) ;
-        if(! imageFile.is_open())
-        {
-            std::cerr << "# Error opening the file!" << std::endl ;
-            return 0 ;
-        }
+    // Read first line and split based on the , and any spaces before or after
+    readRgbHeader(imageFile, &width, &height) ;
 
-        // Read first line and split based on the , and any spaces before or after
-        imageFile >> this->width;
-        imageFile.ignore();
-        imageFile >> this->height;
-        imageFile.ignore();
+    if(! image->allocate(width, height))
+    {
+        std::cerr << "# Cannot allocate memory for the image!" << std::endl ;
+        return 0 ;
+    }
 
-        for (int h = 0 ; h < this->height ; h++)
-        {
-            std::vector<std::shared_ptr<Pixel<T>> > currRow ;
-
-            for(int w = 0 ; w < this->width ; w++)
-            {
-                T r, g, b;
-                readFromStream(imageFile, r);
-                imageFile.ignore();
-                readFromStream(imageFile, g);
-                imageFile.ignore();
-                readFromStream(imageFile, b);
-                imageFile.ignore();
-
-                // Add pixel to the current row
-                std::shared_ptr<Pixel<T>> currPixel(new Pixel<T>(r, g, b)) ;
-                currRow.push_back(currPixel) ;
-            }
-            this->pixels.push_back(currRow) ;
-        }
+    // each row is parsed and split into the channel planes
+    std::vector<double> values(3 * width) ;
 
-        std::string line;
-        std::getline(imageFile, line) ;
-        this->meta = line ;
-        return 1 ;
-    }
-    std::vector<int> exportRgbImage (T scale)
+    for (int h = 0 ; h < height ; h++)
     {
-        std::vector<int> output;
+        readRgbRow(imageFile, values.data(), width) ;
 
-        for(int h = 0 ; h < this->height ; h++)
+        for(int c = 0 ; c < 3 ; c++)
         {
-            for(int w = 0 ; w < this->width; w++)
-            {
-                int red   = (int)(this->pixels[h][w]->r * scale) ;
-                int green = (int)(this->pixels[h][w]->g * scale) ;
-                int blue  = (int)(this->pixels[h][w]->b * scale) ;
-
-                output.push_back(red);
-                output.push_back(green);
-                output.push_back(blue);
-            }
+            T* row = image->row(c, h) ;
+            for(int w = 0 ; w < width ; w++)
+                row[w] = T(values[3 * w + c]) ;
         }
-        return output ;
     }
-    void makeGrayscale()
-    {
-        T rC(0.30 / 256.0);
-        T gC(0.59 / 256.0);
-        T bC(0.11 / 256.0);
 
-        for(int h = 0 ; h < this->height ; h++)
-        {
-            for(int w = 0 ; w < this->width ; w++)
-            {
-                T luminance (( rC * this->pixels[h][w]->r ) +
-                            ( gC * this->pixels[h][w]->g ) +
-                            ( bC * this->pixels[h][w]->b )) ;
-
-                this->pixels[h][w]->r = luminance ;
-                this->pixels[h][w]->g = luminance ;
-                this->pixels[h][w]->b = luminance ;
-            }
-        }
-    }
-} ;
+    std::string line;
+    std::getline(imageFile, line) ;
+    image->meta = line ;
+    return 1 ;
+}
 
+// Sobel operator in separable form on a zero-padded grayscale image: with w the 3x3 window
+// around a pixel, the vertical gradient is [1 2 1] applied to the difference of the rows
+// below and above, and the horizontal gradient is [-1 0 1] applied to [1 2 1]^T smoothed
+// columns. Each row of column sums is computed once and reused by the three pixels that
+// read it, there are no border branches, and every step runs on whole rows with the batch
+// kernels, which are vectorized across pixels for float and double; LNS types have no packed
+// path and run their scalar loop.
+
+// number of rows of the bands that the threads take in turn
+#ifndef SOBEL_BAND_ROWS
+#define SOBEL_BAND_ROWS 16
+#endif
+
+// constants and clamping bounds, converted once per type before main
+template<typename T> const T sobelTwo = T(2);
+template<typename T> const T sobelLuminanceR = T(0.30 / 256.0);
+template<typename T> const T sobelLuminanceG = T(0.59 / 256.0);
+template<typename T> const T sobelLuminanceB = T(0.11 / 256.0);
+
+// 256 / val and 255 / val with val = sqrt(256^2 + 256^2)
+template<typename T> const T sobelBound = T(256) / squareRoot(T(256 * 256 + 256 * 256));
+template<typename T> const T sobelClamp = T(255) / squareRoot(T(256 * 256 + 256 * 256));
+
+// magnitudes are multiplied by val when they are exported
+template<typename T> const T sobelScale = squareRoot(T(256 * 256 + 256 * 256));
+
+// plane surrounded by a border of zeros, pixel (x, y) is at (x + border, y + border) and rows
+// are stride elements apart; row(y) points to the first border element of row y
 template<typename T>
-void window(const std::shared_ptr<Image<T>>& imagePtr, int x, int y, T window[][3])
+struct PaddedPlane
 {
-    window[0][0] = imagePtr->pixels[ y - 1 ][ x - 1 ]->r ;
- 	window[0][1] = imagePtr->pixels[ y - 1 ][ x ]->r ;
- 	window[0][2] = imagePtr->pixels[ y - 1 ][ x + 1 ]->r ;
+    int border;
+    int stride;
+    std::vector<T> values;
 
-	window[1][0] = imagePtr->pixels[ y ][ x - 1 ]->r ;
- 	window[1][1] = imagePtr->pixels[ y ][ x ]->r ;
- 	window[1][2] = imagePtr->pixels[ y ][ x + 1 ]->r ;
+    T* row(int y)
+    {
+        return &values[(size_t)(y + border) * stride];
+    }
 
-	window[2][0] = imagePtr->pixels[ y + 1 ][ x - 1 ]->r ;
- 	window[2][1] = imagePtr->pixels[ y + 1 ][ x ]->r ;
- 	window[2][2] = imagePtr->pixels[ y + 1 ][ x + 1 ]->r ;
-}
+    const T* row(int y) const
+    {
+        return &values[(size_t)(y + border) * stride];
+    }
+};
 
+// allocates a padded plane for an image, borders are zeros
 template<typename T>
-void half_window(const std::shared_ptr<Image<T>>& imagePtr, int x, int y, T window[][3])
+void allocatePadded(const PlanarImage<T>& image, PaddedPlane<T>* plane, int border)
 {
-    window[0][0] = (x == 0 || y == 0) ? T(0) : imagePtr->pixels[y - 1][x - 1]->r;
-	window[0][1] = (y == 0) ? T(0) : imagePtr->pixels[y - 1][x]->r;
-	window[0][2] = (x == imagePtr->width -1 || y == 0) ? T(0) : imagePtr->pixels[y - 1][x + 1]->r;
-
-	window[1][0] = (x == 0) ? T(0) : imagePtr->pixels[y][x - 1]->r;
-	window[1][1] = imagePtr->pixels[y][x]->r;
-	window[1][2] = (x == imagePtr->width -1) ? T(0) : imagePtr->pixels[y][x + 1]->r;
+    plane->border = border ;
+    plane->stride = image.width + 2 * border ;
+    plane->values.assign((size_t)plane->stride * (image.height + 2 * border), T(0)) ;
+}
 
-	window[2][0] = (x == 0 || y == imagePtr->height - 1) ? T(0) : imagePtr->pixels[y + 1][x - 1]->r;
-	window[2][1] = (y == imagePtr->height - 1) ? T(0) : imagePtr->pixels[y + 1][x]->r;
-	window[2][2] = (x == imagePtr->width -1 || y == imagePtr->height - 1) ? T(0) : imagePtr->pixels[y + 1][x + 1]->r;
+// the grayscale plane of Sobel has a border of one pixel
+template<typename T>
+void allocateGrayscale(const PlanarImage<T>& image, PaddedPlane<T>* gray)
+{
+    allocatePadded(image, gray, 1) ;
 }
 
+// luminance = rC * r + gC * g + bC * b of one row, t is a scratch row of width values
 template<typename T>
-T convolve(T w[][3], T k[][3])
+void rowLuminance(const T* r, const T* g, const T* b, int width, T* luminance, T* t)
 {
-    T r(0.0);
-    for( int j = 0 ; j < 3 ; j++ )
-        for ( int i = 0 ; i < 3 ; i++ )
-        {
-            r += w[i][j] * k[j][i] ;
-        }
-    return r ;
+    batchMul(r, sobelLuminanceR<T>, luminance, width) ;
+    batchMul(g, sobelLuminanceG<T>, t, width) ;
+    batchAdd(luminance, t, luminance, width) ;
+    batchMul(b, sobelLuminanceB<T>, t, width) ;
+    batchAdd(luminance, t, luminance, width) ;
 }
 
+// luminance of the rows [begin, end), written after the left border
 template<typename T>
-T sobelW(T w[][3])
+void makeGrayscale(const PlanarImage<T>& image, PaddedPlane<T>* gray, int begin, int end)
 {
-    static T kx[][3] =
-            {
-                    { T(-1), T(-2), T(-1) },
-                    { T(0), T(0), T(0) },
-                    { T(1), T(2), T(1) }
-            } ;
+    std::vector<T> t(image.width) ;
 
-    static T ky[][3] =
-            {
-                    { T(-1), T(0), T(1) },
-                    { T(-2), T(0), T(2) },
-                    { T(-1), T(0), T(1) }
-            } ;
+    for(int h = begin ; h < end ; h++)
+        rowLuminance(image.row(0, h), image.row(1, h), image.row(2, h), image.width, gray->row(h) + 1, t.data()) ;
+}
 
-    static T val = squareRoot(T(256 * 256 + 256 * 256));
+// scratch rows of the Sobel engine for images of a given width
+template<typename T>
+struct SobelBuffers
+{
+    std::vector<T> smooth;      // above + 2 * row + below, padded
+    std::vector<T> diff;        // below - above, padded
+    std::vector<T> gx;
+    std::vector<T> gy;
 
-    T sx = convolve(w, ky) ;
-    T sy = convolve(w, kx) ;
-    T s = squareRoot(sx * sx + sy * sy) ;
+    explicit SobelBuffers(int width) : smooth(width + 2), diff(width + 2), gx(width), gy(width)
+    {
+    }
+};
 
+// gradient magnitudes of one row from the padded rows above, at and below it
+template<typename T>
+void sobelRow(const T* above, const T* row, const T* below, int width, T* out, SobelBuffers<T>& buffers)
+{
+    T* smooth = buffers.smooth.data() ;
+    T* diff = buffers.diff.data() ;
+    T* gx = buffers.gx.data() ;
+    T* gy = buffers.gy.data() ;
+
+    // column sums, including the border columns
+    batchMul(row, sobelTwo<T>, smooth, width + 2) ;
+    batchAdd(smooth, above, smooth, width + 2) ;
+    batchAdd(smooth, below, smooth, width + 2) ;
+    batchSub(below, above, diff, width + 2) ;
+
+    // vertical gradient: diff[x - 1] + 2 * diff[x] + diff[x + 1]
+    batchMul(diff + 1, sobelTwo<T>, gy, width) ;
+    batchAdd(gy, diff, gy, width) ;
+    batchAdd(gy, diff + 2, gy, width) ;
+
+    // horizontal gradient: smooth[x + 1] - smooth[x - 1]
+    batchSub(smooth + 2, smooth, gx, width) ;
+
+    batchSquare(gx, gx, width) ;
+    batchSquare(gy, gy, width) ;
+    batchAdd(gy, gx, out, width) ;
+    batchSqrt(out, out, width) ;
+
+    for(int x = 0 ; x < width ; x++)
+    {
+        if (out[x] >= sobelBound<T>)
+            out[x] = sobelClamp<T>;
+    }
+}
 
-    if (s >= (T(256) / val))
-        s = T(255) / val;
+// computes the rows of dst by bands of bandRows rows, which the threads take in turn; the rows
+// above and below a band are read from the shared padded plane, so bands need no halo copy
+template<typename T>
+void sobelBands(const PaddedPlane<T>& gray, PlanarImage<T>* dst, int bandRows, int nThreads)
+{
+    runBands(dst->height, bandRows, nThreads, [dst]() { return SobelBuffers<T>( dst->width ); },
+             [&gray, dst](SobelBuffers<T>& buffers, int begin, int end) {
+        for (int y = begin ; y < end ; y++) {
+            sobelRow(gray.row(y - 1), gray.row(y), gray.row(y + 1), dst->width, dst->row(0, y), buffers);
 
-    return s ;
+            std::copy(dst->row(0, y), dst->row(0, y) + dst->width, dst->row(1, y));
+            std::copy(dst->row(0, y), dst->row(0, y) + dst->width, dst->row(2, y));
+        }
+    });
 }
 
 template<typename T>
-std::vector<int> sobel(const std::string& inputFileName)
+std::vector<int> sobelImage(const std::string& inputFileName, int bandRows)
 {
-    int x, y;
-    T s(0);
-
     // Source and destination image
-    std::shared_ptr<Image<T>> srcImagePtr(new Image<T>());
-    std::shared_ptr<Image<T>> dstImagePtr(new Image<T>());
-
-    T w[][3] = {
-            {T(0), T(0), T(0)},
-            {T(0), T(0), T(0)},
-            {T(0), T(0), T(0)}
-    };
-
-
-    srcImagePtr->loadRgbImage( inputFileName ); // source image
-    dstImagePtr->loadRgbImage( inputFileName ); // destination image
+    PlanarImage<T> srcImage;
+    PlanarImage<T> dstImage;
+    PaddedPlane<T> grayImage;
 
-    srcImagePtr->makeGrayscale( ); // convert the source file to grayscale
-
-    y = 0 ;
+    loadSobelImage( inputFileName, &srcImage ); // source image
+    dstImage.allocate( srcImage.width, srcImage.height ); // destination image, every pixel is written below
+    dstImage.meta = srcImage.meta;
 
     // Start performing Sobel operation
-    for( x = 0 ; x < srcImagePtr->width ; x++ ) {
-        half_window(srcImagePtr, x, y, w) ;
+    int nThreads = getThreadCount();
+    auto startTime = std::chrono::steady_clock::now();
 
+    // convert the source file to grayscale, each thread converting a contiguous range of rows
+    allocateGrayscale( srcImage, &grayImage );
+    runThreads(nThreads, [&srcImage, &grayImage, nThreads](int tid) {
+        makeGrayscale( srcImage, &grayImage, srcImage.height * tid / nThreads, srcImage.height * (tid + 1) / nThreads );
+    });
 
-        s = sobelW(w);
+    sobelBands( grayImage, &dstImage, bandRows, nThreads );
 
+    auto endTime = std::chrono::steady_clock::now();
+    printThroughput("Sobel throughput on " + std::to_string(nThreads) + " thread(s), bands of " + std::to_string(bandRows) + " rows",
+                    (double)srcImage.width * srcImage.height / 1e6, "megapixels",
+                    std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
 
-        dstImagePtr->pixels[y][x]->r = s ;
-        dstImagePtr->pixels[y][x]->g = s ;
-        dstImagePtr->pixels[y][x]->b = s ;
-    }
+    std::vector<int> output = exportPlanarImage(dstImage, sobelScale<T>) ;
+    return output ;
+}
 
-    for (y = 1 ; y < (srcImagePtr->height - 1) ; y++) {
-        x = 0 ;
-        half_window(srcImagePtr, x, y, w);
+template<typename T>
+std::vector<int> sobel(const std::string& inputFileName)
+{
+    return sobelImage<T>(inputFileName, SOBEL_BAND_ROWS);
+}
 
-        s = sobelW(w);
+// Streaming Sobel: the RGB rows of an image are pushed one at a time, each is converted to
+// luminance on arrival into a ring of three padded rows, and the gradient row it completes
+// is exported right away. The memory used depends on the width of the image only.
+template<typename T>
+struct SobelStream
+{
+    int width;
+    int rowsIn;                 // rows pushed so far
+    std::vector<T> ring[3];     // padded luminance, row y in ring[y % 3]
+    std::vector<T> channels;    // pushed row, as R, G and B planes of width values
+    std::vector<T> scratch;
+    std::vector<int> output;    // last gradient row, scaled to integer levels
+    SobelBuffers<T> buffers;
+
+    explicit SobelStream(int w) : width(w), rowsIn(0), channels(3 * w), scratch(w), output(w), buffers(w)
+    {
+        for(int i = 0 ; i < 3 ; i++)
+            ring[i].assign(w + 2, T(0)) ;
+    }
 
+    // adds the next row of 3 * width interleaved channel values, returns true when it
+    // completes the gradient row above it, which is then in output
+    bool push(const double* rgb)
+    {
+        for(int c = 0 ; c < 3 ; c++)
+            for(int x = 0 ; x < width ; x++)
+                channels[c * width + x] = T(rgb[3 * x + c]) ;
+
+        rowLuminance(&channels[0], &channels[width], &channels[2 * width], width, &ring[rowsIn % 3][1], scratch.data()) ;
+        ++rowsIn ;
+
+        // row -1 is in the slot of row 2, still zeros
+        if(rowsIn < 2)
+            return false ;
+        emit(ring[rowsIn % 3], ring[(rowsIn + 1) % 3], ring[(rowsIn + 2) % 3]) ;
+        return true ;
+    }
 
-        dstImagePtr->pixels[y][x]->r = s ;
-        dstImagePtr->pixels[y][x]->g = s ;
-        dstImagePtr->pixels[y][x]->b = s ;
+    // completes the last row with a zero row below it, returns false if no row was pushed
+    bool finish()
+    {
+        if(rowsIn == 0)
+            return false ;
 
+        std::vector<T>& below = ring[rowsIn % 3] ;
+        std::fill(below.begin(), below.end(), T(0)) ;
+        emit(ring[(rowsIn + 1) % 3], ring[(rowsIn + 2) % 3], below) ;
+        return true ;
+    }
 
-        for( x = 1 ; x < srcImagePtr->width - 1 ; x++ ) {
-            window(srcImagePtr, x, y, w) ;
+    // exports the gradient row like exportPlanarImage does
+    void emit(const std::vector<T>& above, const std::vector<T>& row, const std::vector<T>& below)
+    {
+        sobelRow(above.data(), row.data(), below.data(), width, scratch.data(), buffers) ;
+        batchMul(scratch.data(), sobelScale<T>, scratch.data(), width) ;
+        for(int x = 0 ; x < width ; x++)
+            output[x] = (int)scratch[x] ;
+    }
+};
 
-            s = sobelW(w);
+// reads an image once and streams it through Sobel with both types, comparing the gradient
+// rows as they are produced; only the rows in flight are kept in memory
+template<typename T1, typename T2>
+void sobelStream(const std::string& inputFileName)
+{
+    std::ifstream imageFile(inputFileName.c_str()) ;
+    int width, height ;
+    if(! imageFile.is_open() || ! readRgbHeader(imageFile, &width, &height))
+    {
+        std::cerr << "# Error opening the file!" << std::endl ;
+        return ;
+    }
 
-            dstImagePtr->pixels[y][x]->r = s ;
-            dstImagePtr->pixels[y][x]->g = s ;
-            dstImagePtr->pixels[y][x]->b = s ;
+    SobelStream<T1> stream1( width ) ;
+    SobelStream<T2> stream2( width ) ;
+    std::vector<double> values(3 * width) ;
+    ImageError imageError ;
+    long long int time1 = 0, time2 = 0 ;
 
+    // pixels are exported as 3 identical channels, like the whole-image benchmark
+    auto compareRow = [&stream1, &stream2, &imageError, width]() {
+        for(int x = 0 ; x < width ; x++)
+        {
+            int pixel1[3] = {stream1.output[x], stream1.output[x], stream1.output[x]} ;
+            int pixel2[3] = {stream2.output[x], stream2.output[x], stream2.output[x]} ;
+            imageError.add(pixel1, pixel2) ;
         }
+    };
 
-        x = srcImagePtr->width - 1 ;
-        half_window(srcImagePtr, x, y, w) ;
-
-
-        s = sobelW(w);
+    auto timed = [](long long int* time, const auto& f) {
+        auto start = std::chrono::steady_clock::now() ;
+        bool result = f() ;
+        *time += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() ;
+        return result ;
+    };
 
-        dstImagePtr->pixels[y][x]->r = s ;
-        dstImagePtr->pixels[y][x]->g = s ;
-        dstImagePtr->pixels[y][x]->b = s ;
+    for (int h = 0 ; h < height ; h++)
+    {
+        readRgbRow(imageFile, values.data(), width) ;
+        bool ready1 = timed(&time1, [&stream1, &values]() { return stream1.push(values.data()) ; }) ;
+        bool ready2 = timed(&time2, [&stream2, &values]() { return stream2.push(values.data()) ; }) ;
+        if(ready1 && ready2)
+            compareRow() ;
     }
 
-    y = srcImagePtr->height - 1;
-
-    for(x = 0 ; x < srcImagePtr->width ; x++) {
-        half_window(srcImagePtr, x, y, w) ;
+    if(timed(&time1, [&stream1]() { return stream1.finish() ; }) && timed(&time2, [&stream2]() { return stream2.finish() ; }))
+        compareRow() ;
 
-        s = sobelW(w);
-
-        dstImagePtr->pixels[y][x]->r = s ;
-        dstImagePtr->pixels[y][x]->g = s ;
-        dstImagePtr->pixels[y][x]->b = s ;
-
-    }
-
-    std::vector<int> output = dstImagePtr->exportRgbImage(squareRoot(T(256 * 256 + 256 * 256))) ;
-    return output ;
+    double megapixels = (double)width * height / 1e6 ;
+    printThroughput("Streaming Sobel throughput of the reference type", megapixels, "megapixels", time1) ;
+    printThroughput("Streaming Sobel throughput of the benchmarked type", megapixels, "megapixels", time2) ;
+    printTimeDifference(time1, time2) ;
+    imageError.print() ;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,146 @@
+#ifndef THREADING_HPP
+#define THREADING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads used by the parallel benchmarks, 0 means one per hardware thread
+#ifndef NUM_THREADS
+#define NUM_THREADS 0
+#endif
+
+int getThreadCount()
+{
+    int n = NUM_THREADS;
+    if(n <= 0)
+        n = (int)std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// Worker threads kept for the whole program, so that the parallel steps of the benchmarks (one
+// per k-means iteration) wake idle threads instead of creating and joining new ones. Workers
+// are created when a job needs more threads than the pool has. The pool is never destroyed,
+// its idle workers end with the process.
+class ThreadPool
+{
+public:
+    typedef void (*Job)(const void* context, int tid);
+
+    static ThreadPool& get()
+    {
+        static ThreadPool* pool = new ThreadPool();
+        return *pool;
+    }
+
+    // runs job(context, tid) for tid in [0, nThreads) and waits for all of them, the calling
+    // thread takes part as thread 0; returns false without running the job when the pool is
+    // already running one, for nested or concurrent calls
+    bool run(int nThreads, Job job, const void* context)
+    {
+        std::unique_lock<std::mutex> busy(runMutex, std::try_to_lock);
+        if(!busy.owns_lock())
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while((int)workers.size() < nThreads - 1)
+                workers.emplace_back(&ThreadPool::work, this, (int)workers.size() + 1);
+            currentJob = job;
+            currentContext = context;
+            jobThreads = nThreads;
+            pending = nThreads - 1;
+            ++generation;
+        }
+        wake.notify_all();
+
+        job(context, 0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+        return true;
+    }
+
+private:
+    ThreadPool() = default;
+
+    // waits for each new job and runs it when tid is part of it
+    void work(int tid)
+    {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;)
+        {
+            wake.wait(lock, [this, &seen]() { return generation != seen; });
+            seen = generation;
+            if(tid >= jobThreads)
+                continue;
+
+            Job job = currentJob;
+            const void* context = currentContext;
+            lock.unlock();
+            job(context, tid);
+            lock.lock();
+            if(--pending == 0)
+                done.notify_one();
+        }
+    }
+
+    std::mutex runMutex;                    // held by the thread running a job
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> workers;
+    Job currentJob = nullptr;
+    const void* currentContext = nullptr;
+    int jobThreads = 0;
+    int pending = 0;
+    unsigned long long generation = 0;
+};
+
+// runs f(tid) for tid in [0, nThreads) on the thread pool and waits for all of them, the
+// calling thread takes part as thread 0; calls made while the pool is busy (from a worker, or
+// from another thread such as a pipeline stage) create and join threads of their own
+template<typename F>
+void runThreads(int nThreads, const F& f)
+{
+    if(nThreads <= 1)
+    {
+        f(0);
+        return;
+    }
+
+    ThreadPool::Job job = [](const void* context, int tid) { (*static_cast<const F*>(context))(tid); };
+    if(ThreadPool::get().run(nThreads, job, &f))
+        return;
+
+    std::vector<std::thread> workers;
+    workers.reserve(nThreads - 1);
+    for(int tid = 1; tid < nThreads; ++tid)
+        workers.emplace_back([&f, tid]() { f(tid); });
+
+    f(0);
+
+    for(auto& worker : workers)
+        worker.join();
+}
+
+// splits [0, n) into bands of bandSize items that the threads take in turn, and calls
+// f(state, begin, end) for each band, with state = makeState() created once per thread
+template<typename MakeState, typename F>
+void runBands(int n, int bandSize, int nThreads, const MakeState& makeState, const F& f)
+{
+    std::atomic<int> nextBand(0);
+    const int nBands = (n + bandSize - 1) / bandSize;
+
+    runThreads(nThreads, [&](int) {
+        auto state = makeState();
+        for(int band = nextBand++; band < nBands; band = nextBand++)
+            f(state, band * bandSize, std::min(n, (band + 1) * bandSize));
+    });
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <cmath>
 #include "utilities.hpp"
+#include "reduction.hpp"
 
 /* if USE_EPSILON_TEST is true the we do a check:
 		if |dv|<EPSILON then dv=0.0;
@@ -20,7 +21,7 @@
               dest[1]=v1[2]*v2[0]-v1[0]*v2[2]; \
               dest[2]=v1[0]*v2[1]-v1[1]*v2[0];
 
-#define DOT(v1,v2) (v1[0]*v2[0]+v1[1]*v2[1]+v1[2]*v2[2])
+#define DOT(v1,v2) dot<3>(v1,v2)
 
 #define SUB(dest,v1,v2) dest[0]=v1[0]-v2[0]; dest[1]=v1[1]-v2[1]; dest[2]=v1[2]-v2[2];
 
@@ -2,7 +2,11 @@
 #define BENCHMARK_UTILITIES_HPP
 
 #include <cmath>
+#include <cctype>
+#include <istream>
 #include "../lns.hpp"
+#include "lnsmath.hpp"
+#include "lnstables.hpp"
 
 template<typename T>
 T squareRoot(T value)
@@ -13,7 +17,7 @@ T squareRoot(T value)
 template<int I, int F, int A>
 lns::lns_t<I, F, A> squareRoot(lns::lns_t<I, F, A> value)
 {
-    return value.sqrt();
+    return lnsUnary<LNS_SQRT>(value, [](lns::lns_t<I, F, A> x) { return x.sqrt(); });
 }
 
 
@@ -23,11 +27,29 @@ T naturalLog(T value)
     return std::log(value);
 }
 
+// the stored exponent already is log2(value), only the scaling to base e remains
 template<int I, int F, int A>
 lns::lns_t<I, F, A> naturalLog(lns::lns_t<I, F, A> value)
 {
-    static lns::lns_t<I, F, A> log2E(log2(M_E));
-    return lns::lns_t<I, F, A>(value.template log2<double>()) / log2E;
+    return lnsUnary<LNS_LOG>(value, [](lns::lns_t<I, F, A> x) {
+        return lns::lns_t<I, F, A>(x.template log2<double>() * M_LN2);
+    });
+}
+
+template<typename T>
+T expValue(T value)
+{
+    return std::exp(value);
+}
+
+// exp goes through double: building the result from its exponent x * log2(e) with a table of
+// powers of two was several times slower (EXP mode)
+template<int I, int F, int A>
+lns::lns_t<I, F, A> expValue(lns::lns_t<I, F, A> value)
+{
+    return lnsUnary<LNS_EXP>(value, [](lns::lns_t<I, F, A> x) {
+        return lns::lns_t<I, F, A>(std::exp((double)x));
+    });
 }
 
 template<typename T>
@@ -42,6 +64,37 @@ lns::lns_t<I, F, A> square(lns::lns_t<I, F, A> value)
     return value.square();
 }
 
+// a * b + c with two roundings, as written in the benchmarks: -std=c++14 makes GCC keep the
+// multiplication and the addition separate (-ffp-contract=off)
+template<typename T>
+T fmaValue(T a, T b, T c)
+{
+    return a * b + c;
+}
+
+// the multiplication is an exact exponent addition in LNS and the addition is the costly
+// part, so it is skipped when a zero factor makes the product zero, that is when the other
+// factor is finite (0 * inf and 0 * NaN are NaN)
+template<int I, int F, int A>
+lns::lns_t<I, F, A> fmaValue(lns::lns_t<I, F, A> a, lns::lns_t<I, F, A> b, lns::lns_t<I, F, A> c)
+{
+    if((a.isZero() && !b.isNan() && !b.isInf()) || (b.isZero() && !a.isNan() && !a.isInf()))
+        return c;
+    if(c.isZero())
+        return a * b;
+    return a * b + c;
+}
+
+// coeffs[0] + x * (coeffs[1] + x * (... + x * coeffs[N - 1])), one multiply-add per coefficient
+template<typename T, size_t N>
+T hornerValue(T x, const T (&coeffs)[N])
+{
+    T result = coeffs[N - 1];
+    for(size_t i = N - 1; i > 0; --i)
+        result = fmaValue(result, x, coeffs[i - 1]);
+    return result;
+}
+
 template<typename T>
 bool isZero(T value)
 {
@@ -87,7 +140,7 @@ T cosValue(T value)
 template<int I, int F, int A>
 lns::lns_t<I, F, A> cosValue(lns::lns_t<I, F, A> value)
 {
-    return lns::lns_t<I, F, A>(std::cos((double)value));
+    return lnsUnary<LNS_COS>(value, [](lns::lns_t<I, F, A> x) { return lnsCos(x); });
 }
 
 template<typename T>
@@ -99,7 +152,27 @@ T sinValue(T value)
 template<int I, int F, int A>
 lns::lns_t<I, F, A> sinValue(lns::lns_t<I, F, A> value)
 {
-    return lns::lns_t<I, F, A>(std::sin((double)value));
+    return lnsUnary<LNS_SIN>(value, [](lns::lns_t<I, F, A> x) { return lnsSin(x); });
+}
+
+// sin and cos of the same angle, compilers merge the two libm calls into one sincos call
+template<typename T>
+void sinCosValue(T value, T* s, T* c)
+{
+    *s = std::sin(value);
+    *c = std::cos(value);
+}
+
+template<int I, int F, int A>
+void sinCosValue(lns::lns_t<I, F, A> value, lns::lns_t<I, F, A>* s, lns::lns_t<I, F, A>* c)
+{
+    if(LnsTableEligible<lns::lns_t<I, F, A>>::value)
+    {
+        *s = sinValue(value);
+        *c = cosValue(value);
+    }
+    else
+        lnsSinCos(value, s, c);
 }
 
 template<typename T>
@@ -123,7 +196,7 @@ T acosValue(T value)
 template<int I, int F, int A>
 lns::lns_t<I, F, A> acosValue(lns::lns_t<I, F, A> value)
 {
-    return lns::lns_t<I, F, A>(std::acos(std::min(1.0, std::max(-1.0, (double)value))));
+    return lnsUnary<LNS_ACOS>(value, [](lns::lns_t<I, F, A> x) { return lnsAcos(x); });
 }
 
 template<typename T>
@@ -135,7 +208,7 @@ T asinValue(T value)
 template<int I, int F, int A>
 lns::lns_t<I, F, A> asinValue(lns::lns_t<I, F, A> value)
 {
-    return lns::lns_t<I, F, A>(std::asin(std::min(1.0, std::max(-1.0, (double)value))));
+    return lnsUnary<LNS_ASIN>(value, [](lns::lns_t<I, F, A> x) { return lnsAsin(x); });
 }
 
 template<typename T>
@@ -152,4 +225,12 @@ void readFromStream(std::istream& stream, lns::lns_t<I, F, A>& value)
     value = lns::lns_t<I, F, A>(dbl);
 }
 
+// skip a whitespace-separated field without converting it
+void skipField(std::istream& stream)
+{
+    stream >> std::ws;
+    while(stream && !std::isspace(stream.peek()) && stream.peek() != std::char_traits<char>::eof())
+        stream.get();
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef VIDEO_HPP
+#define VIDEO_HPP
+
+// Video modes of the image benchmarks: Sobel and k-means run on a sequence of frames through
+// the pipeline of pipeline.hpp, to measure their steady-state frame rate and latency once the
+// setup is paid. The image file is parsed once, frame f is the image scrolled up by f rows, so
+// that consecutive frames differ as in a moving scene.
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "pipeline.hpp"
+#include "planarimage.hpp"
+#include "batch.hpp"
+#include "sobel.hpp"
+#include "kmeans.hpp"
+
+// interleaved channel values of the image that the frames are made of
+struct VideoSource
+{
+    int width;
+    int height;
+    std::vector<double> values;
+
+    bool load(const std::string& fileName)
+    {
+        std::ifstream imageFile(fileName.c_str());
+        if(!imageFile.is_open() || !readRgbHeader(imageFile, &width, &height))
+        {
+            std::cerr << "# Error opening the file!" << std::endl;
+            return false;
+        }
+
+        values.resize(3 * (size_t)width * height);
+        for(int y = 0; y < height; ++y)
+            readRgbRow(imageFile, &values[3 * (size_t)y * width], width);
+        return true;
+    }
+
+    const double* row(int frame, int y) const
+    {
+        return &values[3 * (size_t)((y + frame) % height) * width];
+    }
+};
+
+// converts a frame of the source into the channel planes of an image
+template<typename T>
+void loadFrame(const VideoSource& source, int frame, PlanarImage<T>* image)
+{
+    for(int y = 0; y < source.height; ++y)
+    {
+        const double* values = source.row(frame, y);
+        for(int c = 0; c < 3; ++c)
+        {
+            T* row = image->row(c, y);
+            for(int x = 0; x < source.width; ++x)
+                row[x] = T(values[3 * x + c]);
+        }
+    }
+}
+
+template<typename T>
+std::vector<int> sobelVideo(const std::string& inputFileName)
+{
+    VideoSource source;
+    if(!source.load(inputFileName))
+        return std::vector<int>();
+
+    PaddedPlane<T> gray;
+
+    return runPipeline<T>("Sobel video", VIDEO_FRAMES,
+        [&source](VideoFrame<T>& frame) {
+            if(frame.image.width == 0)
+            {
+                frame.image.allocate(source.width, source.height);
+                frame.result.allocate(source.width, source.height);
+            }
+            loadFrame(source, frame.index, &frame.image);
+        },
+        [&gray](VideoFrame<T>& frame) {
+            if(gray.values.empty())
+                allocateGrayscale(frame.image, &gray);
+            makeGrayscale(frame.image, &gray, 0, frame.image.height);
+            sobelBands(gray, &frame.result, SOBEL_BAND_ROWS, 1);
+        },
+        [](VideoFrame<T>& frame) {
+            frame.output = exportPlanarImage(frame.result, sobelScale<T>);
+        });
+}
+
+// the centroids of each frame are seeded with its index, so that both types start from the
+// same centroids
+template<typename T>
+std::vector<int> kmeansVideo(const std::string& inputFileName)
+{
+    VideoSource source;
+    if(!source.load(inputFileName))
+        return std::vector<int>();
+
+    return runPipeline<T>("Kmeans video", VIDEO_FRAMES,
+        [&source](VideoFrame<T>& frame) {
+            if(frame.image.width == 0)
+                frame.image.allocate(source.width, source.height, true, true);
+            loadFrame(source, frame.index, &frame.image);
+            for(int c = 0; c < 3; ++c)
+                for(int y = 0; y < source.height; ++y)
+                    batchDiv(frame.image.row(c, y), T(256), frame.image.row(c, y), source.width);
+        },
+        [](VideoFrame<T>& frame) {
+            Clusters<T> clusters;
+            srand(frame.index);
+            initClusters(&clusters, KMEANS_CLUSTERS, T(1));
+            segmentImage(&frame.image, &clusters, KMEANS_ITERATIONS, KMEANS_THRESHOLD, 1);
+            freeClusters(&clusters);
+        },
+        [](VideoFrame<T>& frame) {
+            frame.output = exportRgbImage(frame.image, T(256));
+        });
+}
+
+#endif
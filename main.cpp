@@ -13,7 +13,9 @@
 #include "benchmarks/inversek2j.hpp"
 #include "benchmarks/jmeint.hpp"
 #include "benchmarks/sobel.hpp"
+#include "benchmarks/convolution.hpp"
 #include "benchmarks/kmeans.hpp"
+#include "benchmarks/video.hpp"
 
 using namespace std;
 using namespace lns;
@@ -105,16 +107,23 @@ void tests()
     }
 }
 
-// function to get the name of a LNS type
+// class to get the name of a LNS type
+template<typename T>
+struct TypeName
+{
+    static string get() { return "lns_t<" + to_string(T::integerBits) + ", " + to_string(T::fractionalBits) + ", " + to_string(T::approximationLevel) + ">"; }
+};
+// template specializations to get the name of floating-point types and counting types
+template<> struct TypeName<float> { static string get() { return "float"; } };
+template<> struct TypeName<double> { static string get() { return "double"; } };
+template<> struct TypeName<long double> { static string get() { return "long double"; } };
+template<typename T> struct TypeName<counting_t<T>> { static string get() { return "counting_t<" + TypeName<T>::get() + ">"; } };
+
 template<typename T>
 string getTypeName()
 {
-    return "lns_t<" + to_string(T::integerBits) + ", " + to_string(T::fractionalBits) + ", " + to_string(T::approximationLevel) + ">";
+    return TypeName<T>::get();
 }
-// template specializations to get the name of floating-point type
-template<> string getTypeName<float>() { return "float"; }
-template<> string getTypeName<double>() { return "double"; }
-template<> string getTypeName<long double>() { return "long double"; }
 
 int main()
 {
@@ -129,6 +138,25 @@ int main()
         cout << "-------------------------------------------------------------" << endl;
         runBenchmark(fft<T1>, fft<T2>, 32768);
     #endif
+    #ifdef BENCHMARK_FFT_SIZES
+        for(int n : {1000, 1536, 48000, 1009, 4099})
+        {
+            cout << "-------------------------------------------------------------" << endl;
+            cout << "Running benchmark FFT of size " << n << ", comparing " << typeName2 << " to " << typeName1 << endl;
+            cout << "-------------------------------------------------------------" << endl;
+            runBenchmark(fft<T1>, fft<T2>, n);
+        }
+    #endif
+    #ifdef BENCHMARK_FFT_POLAR
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running benchmark FFT, comparing polar " << typeName2 << " (Cartesian addition) to " << typeName1 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        runBenchmark(fft<T1>, fftPolar<T2, CartesianAddition>, 32768);
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running benchmark FFT, comparing polar " << typeName2 << " (ratio addition) to " << typeName1 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        runBenchmark(fft<T1>, fftPolar<T2, RatioAddition>, 32768);
+    #endif
     #ifdef BENCHMARK_BLACKSCHOLES
         cout << "-------------------------------------------------------------" << endl;
         cout << "Running benchmark Black-Scholes, comparing " << typeName2 << " to " << typeName1 << endl;
@@ -153,12 +181,91 @@ int main()
         cout << "-------------------------------------------------------------" << endl;
         runBenchmark(sobel<T1>, sobel<T2>, "benchmarks/sobel.rgb");
     #endif
+    #ifdef BENCHMARK_SOBEL_BANDS
+        for(int bandRows : {1, 4, 16, 64, 256})
+        {
+            cout << "-------------------------------------------------------------" << endl;
+            cout << "Running benchmark Sobel with bands of " << bandRows << " rows, comparing " << typeName2 << " to " << typeName1 << endl;
+            cout << "-------------------------------------------------------------" << endl;
+            runBenchmark([](int rows) { return sobelImage<T1>("benchmarks/sobel.rgb", rows); },
+                         [](int rows) { return sobelImage<T2>("benchmarks/sobel.rgb", rows); }, bandRows);
+        }
+    #endif
+    #ifdef BENCHMARK_SOBEL_STREAM
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running benchmark Sobel on a stream of rows, comparing " << typeName2 << " to " << typeName1 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        sobelStream<T1, T2>("benchmarks/sobel.rgb");
+        cout << endl;
+    #endif
+    #ifdef BENCHMARK_CONVOLUTION
+        for(int size : {3, 5, 7})
+        {
+            for(const KernelDescription& kernel : {boxKernel(size), gaussianKernel(size), diskKernel(size)})
+            {
+                cout << "-------------------------------------------------------------" << endl;
+                cout << "Running benchmark " << kernel.name << " convolution, comparing " << typeName2 << " to " << typeName1 << endl;
+                cout << "-------------------------------------------------------------" << endl;
+                runBenchmark([](const KernelDescription& k) { return convolutionImage<T1>("benchmarks/sobel.rgb", k); },
+                             [](const KernelDescription& k) { return convolutionImage<T2>("benchmarks/sobel.rgb", k); }, kernel);
+            }
+        }
+    #endif
     #ifdef BENCHMARK_KMEANS
         cout << "-------------------------------------------------------------" << endl;
         cout << "Running benchmark Kmeans, comparing " << typeName2 << " to " << typeName1 << endl;
         cout << "-------------------------------------------------------------" << endl;
         runBenchmark(kmeans<T1>, kmeans<T2>, "benchmarks/kmeans.rgb");
     #endif
+    #ifdef BENCHMARK_KMEANS_COLORS
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running benchmark Kmeans on distinct colors, comparing " << typeName2 << " to " << typeName1 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        runBenchmark(kmeansColors<T1>, kmeansColors<T2>, "benchmarks/kmeans.rgb");
+    #endif
+    #ifdef BENCHMARK_KMEANS_BOUNDS
+        for(int k : {6, 64})
+        {
+            cout << "-------------------------------------------------------------" << endl;
+            cout << "Running benchmark Kmeans with " << k << " clusters and distance bounds, comparing " << typeName2 << " to " << typeName1 << endl;
+            cout << "-------------------------------------------------------------" << endl;
+            runBenchmark([](int clusters) { return kmeansAlgorithms<T1>("benchmarks/kmeans.rgb", clusters); },
+                         [](int clusters) { return kmeansAlgorithms<T2>("benchmarks/kmeans.rgb", clusters); }, k);
+        }
+    #endif
+    #ifdef BENCHMARK_SOBEL_VIDEO
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running benchmark Sobel on " << VIDEO_FRAMES << " frames, comparing " << typeName2 << " to " << typeName1 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        runBenchmark(sobelVideo<T1>, sobelVideo<T2>, "benchmarks/sobel.rgb");
+    #endif
+    #ifdef BENCHMARK_KMEANS_VIDEO
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running benchmark Kmeans on " << VIDEO_FRAMES << " frames, comparing " << typeName2 << " to " << typeName1 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        runBenchmark(kmeansVideo<T1>, kmeansVideo<T2>, "benchmarks/kmeans.rgb");
+    #endif
+    #ifdef BENCHMARK_TRIG
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running trigonometric microbenchmark on " << typeName2 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        trigonometry<T2, 1000000>();
+        cout << endl;
+    #endif
+    #ifdef BENCHMARK_EXP
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running exponential microbenchmark on " << typeName2 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        exponential<T2, 1000000>();
+        cout << endl;
+    #endif
+    #ifdef BENCHMARK_REDUCTION
+        cout << "-------------------------------------------------------------" << endl;
+        cout << "Running reduction microbenchmark on " << typeName2 << endl;
+        cout << "-------------------------------------------------------------" << endl;
+        reduction<T2, 1000000>();
+        cout << endl;
+    #endif
 
     return 0;
 }